@@ -0,0 +1,19 @@
+#!/bin/bash
+# wswitch Switcher - Render every theme offscreen (no compositor needed)
+# Usage: scripts/render-themes.sh [fixture.json] [output-dir] [repeat]
+
+set -e
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+FIXTURE="${1:-$ROOT/scripts/fixture-windows.json}"
+OUT_DIR="${2:-$ROOT/theme-renders}"
+REPEAT="${3:-20}"
+WSWITCH="${WSWITCH:-$ROOT/wswitch}"
+
+mkdir -p "$OUT_DIR"
+
+for theme in "$ROOT"/themes/*.ini; do
+    name="$(basename "$theme" .ini)"
+    "$WSWITCH" --render-png "$OUT_DIR/$name.png" --windows "$FIXTURE" \
+        --theme "$theme" --repeat "$REPEAT" 2>/dev/null
+done
@@ -0,0 +1,47 @@
+#!/bin/bash
+# wswitch Switcher - Capture window thumbnails in a headless compositor
+# Usage: scripts/thumbnail-test.sh [output-dir] [client]
+# Needs sway >= 1.11 (ext-image-copy-capture-v1) and a Wayland client
+
+set -e
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+OUT_DIR="${1:-$ROOT/thumbnail-captures}"
+CLIENT="${2:-foot}"
+WSWITCH="${WSWITCH:-$ROOT/wswitch}"
+
+RUNTIME="$(mktemp -d)"
+trap 'kill $SWAY_PID 2>/dev/null || true; rm -rf "$RUNTIME"' EXIT
+
+cat > "$RUNTIME/sway.conf" <<CONF
+output HEADLESS-1 resolution 1280x800
+exec $CLIENT
+exec $CLIENT
+CONF
+
+export XDG_RUNTIME_DIR="$RUNTIME"
+export WLR_BACKENDS=headless
+export WLR_LIBINPUT_NO_DEVICES=1
+unset WAYLAND_DISPLAY DISPLAY
+sway -c "$RUNTIME/sway.conf" --unsupported-gpu 2>"$RUNTIME/sway.log" &
+SWAY_PID=$!
+
+# Wait for sway's socket, then give the clients time to map
+for _ in $(seq 50); do
+    socket="$(find "$RUNTIME" -maxdepth 1 -type s -name 'wayland-*' | head -n1)"
+    [ -n "$socket" ] && break
+    sleep 0.1
+done
+if [ -z "$socket" ]; then
+    cat "$RUNTIME/sway.log" >&2
+    exit 1
+fi
+export WAYLAND_DISPLAY="$(basename "$socket")"
+sleep 2
+
+mkdir -p "$OUT_DIR"
+"$WSWITCH" --capture-thumbnails "$OUT_DIR"
+
+count=$(find "$OUT_DIR" -name 'window-*.png' | wc -l)
+echo "Captured $count window(s) into $OUT_DIR"
+[ "$count" -gt 0 ]
@@ -14,10 +14,14 @@ static Backend backends[] = {{.type = BACKEND_WLR,
                               .cleanup = wlr_backend_cleanup,
                               .get_windows = wlr_get_windows,
                               .activate_window = wlr_activate_window,
-                              .get_name = wlr_get_name}};
+                              .get_name = wlr_get_name,
+                              .get_active_output = wlr_get_active_output}};
 
 static Backend *current_backend = NULL;
 
+window_changed_callback_t on_window_changed = NULL;
+list_changed_callback_t on_list_changed = NULL;
+
 /* Helper function to detect which backend to use */
 static BackendType detect_backend(void) { return BACKEND_WLR; }
 
@@ -17,8 +17,21 @@ typedef struct {
   int (*get_windows)(AppState *state, Config *config);
   void (*activate_window)(const char *identifier);
   const char *(*get_name)(void);
+  /* Output showing the focused window, NULL if unknown (optional) */
+  struct wl_output *(*get_active_output)(void);
 } Backend;
 
+/* Callback when a window's title or app_id changes or it closes
+ * (set by main.c). old_title is the title going away, or NULL. */
+typedef void (*window_changed_callback_t)(const char *identifier,
+                                          const char *old_title);
+extern window_changed_callback_t on_window_changed;
+
+/* Callback when the window list or its focus order may have changed
+ * (set by main.c). Called from event dispatch: must not dispatch. */
+typedef void (*list_changed_callback_t)(void);
+extern list_changed_callback_t on_list_changed;
+
 /* Initialize backend system, auto-detects which backend to use */
 Backend *backend_init(struct wl_display *display);
 
@@ -0,0 +1,616 @@
+/* src/bench.c - Built-in Micro-benchmarks
+ *
+ * Run with: wswitch --bench <name>. Each benchmark times the variants of
+ * a kernel (scalar and vectorized, serial and parallel) on the same input
+ * and compares their output, so a regression in either speed or output
+ * shows up here.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include "config.h"
+#include "data.h"
+#include "downscale.h"
+#include "glyph_atlas.h"
+#include "icons.h"
+#include "render.h"
+#include "shadow.h"
+#include "text.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef int (*BenchFn)(void);
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* --- Box blur --- */
+
+#define BLUR_SIZE 1024
+#define BLUR_RADIUS 8
+#define BLUR_ITERATIONS 20
+
+static void fill_noise(uint8_t *data, size_t size) {
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < size; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+static int bench_blur(void) {
+  size_t size = (size_t)BLUR_SIZE * BLUR_SIZE;
+  uint8_t *input = malloc(size);
+  uint8_t *reference = malloc(size);
+  uint8_t *work = malloc(size);
+  if (!input || !reference || !work) {
+    free(input);
+    free(reference);
+    free(work);
+    return 1;
+  }
+
+  fill_noise(input, size);
+  memcpy(reference, input, size);
+  shadow_blur_a8(SHADOW_KERNEL_SCALAR, reference, BLUR_SIZE, BLUR_SIZE,
+                 BLUR_SIZE, BLUR_RADIUS);
+
+  printf("blur: %dx%d A8, radius %d, 3 passes per axis\n", BLUR_SIZE,
+         BLUR_SIZE, BLUR_RADIUS);
+
+  int rc = 0;
+  double scalar_ms = 0;
+  for (int k = 0; k < SHADOW_KERNEL_COUNT; k++) {
+    if (!shadow_kernel_supported(k)) {
+      printf("  %-8s unsupported\n", shadow_kernel_name(k));
+      continue;
+    }
+
+    /* Output check against the scalar kernel */
+    memcpy(work, input, size);
+    shadow_blur_a8(k, work, BLUR_SIZE, BLUR_SIZE, BLUR_SIZE, BLUR_RADIUS);
+    bool match = memcmp(work, reference, size) == 0;
+    if (!match)
+      rc = 1;
+
+    double start = now_ms();
+    for (int i = 0; i < BLUR_ITERATIONS; i++) {
+      memcpy(work, input, size);
+      shadow_blur_a8(k, work, BLUR_SIZE, BLUR_SIZE, BLUR_SIZE, BLUR_RADIUS);
+    }
+    double ms = (now_ms() - start) / BLUR_ITERATIONS;
+    if (k == SHADOW_KERNEL_SCALAR)
+      scalar_ms = ms;
+
+    printf("  %-8s %8.3f ms  %7.1f Mpx/s  %5.2fx  %s\n",
+           shadow_kernel_name(k), ms, size / ms / 1000.0,
+           ms > 0 ? scalar_ms / ms : 0, match ? "ok" : "MISMATCH");
+  }
+
+  free(input);
+  free(reference);
+  free(work);
+  return rc;
+}
+
+/* --- Tiled grid rasterization --- */
+
+#define TILES_ITERATIONS 5
+#define TILES_COLS 16 /* Fills a 4K output at 1x */
+
+static const int tile_window_counts[] = {20, 100, 500};
+
+static const char *const tile_classes[] = {
+    "firefox", "kitty", "code", "thunar", "mpv", "gimp", "slack",
+};
+
+#define NUM_TILE_CLASSES                                                       \
+  (int)(sizeof(tile_classes) / sizeof(tile_classes[0]))
+
+static int fill_windows(AppState *state, int count) {
+  for (int i = 0; i < count; i++) {
+    char address[32];
+    char title[96];
+    snprintf(address, sizeof(address), "0x%06x", 0x1000 + i);
+    snprintf(title, sizeof(title), "Window %d - a long document title that "
+             "has to be ellipsized", i);
+
+    WindowInfo win = {0};
+    win.address = strdup(address);
+    win.title = strdup(title);
+    win.class_name = strdup(tile_classes[i % NUM_TILE_CLASSES]);
+    win.workspace_id = 1 + i % 9;
+    win.focus_history_id = i;
+    win.group_count = (i % 11 == 0) ? 3 : 1;
+    if (!win.address || !win.title || !win.class_name ||
+        app_state_add(state, &win) < 0) {
+      window_info_free(&win);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Cold-cache frame: the card cache is emptied by render_set_config() */
+static double first_frame_ms(Config *cfg, AppState *state,
+                             unsigned char *data, uint32_t width,
+                             uint32_t height) {
+  double total = 0;
+  for (int i = 0; i < TILES_ITERATIONS; i++) {
+    render_set_config(cfg);
+    total += render_to_memory(state, data, width, height, width * 4);
+  }
+  return total / TILES_ITERATIONS;
+}
+
+static int bench_tiles(void) {
+  Config *cfg = get_default_config();
+  if (!cfg)
+    return 1;
+  cfg->max_cols = TILES_COLS;
+  cfg->max_rows = 0; /* Every row visible: worst case first frame */
+  icons_init(cfg->icon_theme, cfg->icon_fallback);
+
+  printf("tiles: first frame with an empty card cache, %d columns\n",
+         TILES_COLS);
+
+  int rc = 0;
+  for (size_t n = 0; n < sizeof(tile_window_counts) / sizeof(int); n++) {
+    AppState state;
+    app_state_init(&state);
+    if (fill_windows(&state, tile_window_counts[n]) < 0) {
+      app_state_free(&state);
+      rc = 1;
+      break;
+    }
+
+    render_set_config(cfg);
+    uint32_t width, height;
+    calculate_dimensions(&state, &width, &height);
+    size_t size = (size_t)width * height * 4;
+    unsigned char *serial = malloc(size);
+    unsigned char *parallel = malloc(size);
+    if (!serial || !parallel) {
+      free(serial);
+      free(parallel);
+      app_state_free(&state);
+      rc = 1;
+      break;
+    }
+
+    /* One untimed frame each, so fonts are loaded on every thread */
+    cfg->render_threads = 1;
+    render_set_config(cfg);
+    render_to_memory(&state, serial, width, height, width * 4);
+    double serial_ms = first_frame_ms(cfg, &state, serial, width, height);
+
+    cfg->render_threads = 0;
+    render_set_config(cfg);
+    render_to_memory(&state, parallel, width, height, width * 4);
+    double parallel_ms = first_frame_ms(cfg, &state, parallel, width, height);
+
+    size_t differ = 0;
+    for (size_t i = 0; i < size; i += 4) {
+      if (memcmp(serial + i, parallel + i, 4) != 0)
+        differ++;
+    }
+
+    printf("  %3d windows  %4ux%-5u serial %8.3f ms  parallel %8.3f ms  "
+           "%5.2fx  ",
+           tile_window_counts[n], width, height, serial_ms, parallel_ms,
+           parallel_ms > 0 ? serial_ms / parallel_ms : 0);
+    if (differ == 0)
+      printf("identical\n");
+    else
+      printf("%zu px differ\n", differ);
+
+    free(serial);
+    free(parallel);
+    app_state_free(&state);
+  }
+
+  render_cleanup();
+  icons_cleanup();
+  free_config(cfg);
+  return rc;
+}
+
+/* --- Icon downscaling --- */
+
+#define DOWNSCALE_ITERATIONS 50
+/* Below this the area filter looks visibly different from Cairo's */
+#define DOWNSCALE_MIN_PSNR 30.0
+
+static const struct {
+  int from;
+  int to;
+} downscale_cases[] = {{512, 64}, {256, 64}, {256, 48}};
+
+/* Something icon-like: soft gradients, hard edges, thin lines and
+ * transparency, premultiplied as PNGs come out of Cairo */
+static cairo_surface_t *draw_test_icon(int size) {
+  cairo_surface_t *surface =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+  cairo_t *cr = cairo_create(surface);
+  double s = size;
+
+  cairo_pattern_t *grad = cairo_pattern_create_linear(0, 0, s, s);
+  cairo_pattern_add_color_stop_rgba(grad, 0, 0.20, 0.55, 0.95, 1.0);
+  cairo_pattern_add_color_stop_rgba(grad, 1, 0.60, 0.10, 0.70, 0.85);
+  cairo_new_sub_path(cr);
+  cairo_arc(cr, s * 0.8, s * 0.2, s * 0.1, -M_PI / 2, 0);
+  cairo_arc(cr, s * 0.8, s * 0.8, s * 0.1, 0, M_PI / 2);
+  cairo_arc(cr, s * 0.2, s * 0.8, s * 0.1, M_PI / 2, M_PI);
+  cairo_arc(cr, s * 0.2, s * 0.2, s * 0.1, M_PI, 3 * M_PI / 2);
+  cairo_close_path(cr);
+  cairo_set_source(cr, grad);
+  cairo_fill(cr);
+  cairo_pattern_destroy(grad);
+
+  cairo_set_source_rgba(cr, 1, 1, 1, 0.9);
+  cairo_arc(cr, s * 0.5, s * 0.5, s * 0.22, 0, 2 * M_PI);
+  cairo_fill(cr);
+
+  cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
+  cairo_set_line_width(cr, s / 128.0);
+  for (int i = 1; i < 8; i++) {
+    cairo_move_to(cr, s * 0.3, s * (0.3 + i * 0.05));
+    cairo_line_to(cr, s * 0.7, s * (0.3 + i * 0.05));
+  }
+  cairo_stroke(cr);
+
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+  return surface;
+}
+
+/* What load_png_icon did before: Cairo with CAIRO_FILTER_BEST */
+static void cairo_downscale(cairo_surface_t *src, cairo_surface_t *dst,
+                            double scale) {
+  cairo_t *cr = cairo_create(dst);
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_scale(cr, scale, scale);
+  cairo_set_source_surface(cr, src, 0, 0);
+  cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BEST);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_flush(dst);
+}
+
+/* Largest channel difference and PSNR in dB of two ARGB32 images */
+static double image_psnr(const uint8_t *a, const uint8_t *b, int width,
+                         int height, int stride, int *max_diff) {
+  double sq = 0;
+  *max_diff = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width * 4; x++) {
+      int d = abs(a[y * stride + x] - b[y * stride + x]);
+      if (d > *max_diff)
+        *max_diff = d;
+      sq += d * d;
+    }
+  }
+  double mse = sq / ((double)width * height * 4);
+  return mse > 0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+static int bench_downscale(void) {
+  printf("downscale: premultiplied ARGB32 icon, area filter vs Cairo "
+         "FILTER_BEST\n");
+
+  int rc = 0;
+  for (size_t n = 0; n < sizeof(downscale_cases) / sizeof(downscale_cases[0]);
+       n++) {
+    int from = downscale_cases[n].from;
+    int to = downscale_cases[n].to;
+    cairo_surface_t *src = draw_test_icon(from);
+    cairo_surface_t *ref =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, to, to);
+    const uint8_t *src_data = cairo_image_surface_get_data(src);
+    int src_stride = cairo_image_surface_get_stride(src);
+    int stride = cairo_image_surface_get_stride(ref);
+    size_t size = (size_t)stride * to;
+    uint8_t *scalar = malloc(size);
+    uint8_t *work = malloc(size);
+    if (!scalar || !work) {
+      free(scalar);
+      free(work);
+      cairo_surface_destroy(src);
+      cairo_surface_destroy(ref);
+      return 1;
+    }
+
+    double scale = (double)to / from;
+    double start = now_ms();
+    for (int i = 0; i < DOWNSCALE_ITERATIONS; i++)
+      cairo_downscale(src, ref, scale);
+    double cairo_ms = (now_ms() - start) / DOWNSCALE_ITERATIONS;
+
+    printf("  %d -> %d\n", from, to);
+    printf("    %-8s %8.3f ms\n", "cairo", cairo_ms);
+
+    downscale_argb32(DOWNSCALE_KERNEL_SCALAR, src_data, from, from,
+                     src_stride, scalar, to, to, stride);
+    for (int k = 0; k < DOWNSCALE_KERNEL_COUNT; k++) {
+      if (!downscale_kernel_supported(k)) {
+        printf("    %-8s unsupported\n", downscale_kernel_name(k));
+        continue;
+      }
+
+      /* Output check against the scalar kernel */
+      memset(work, 0, size);
+      downscale_argb32(k, src_data, from, from, src_stride, work, to, to,
+                       stride);
+      bool match = memcmp(work, scalar, size) == 0;
+      if (!match)
+        rc = 1;
+
+      start = now_ms();
+      for (int i = 0; i < DOWNSCALE_ITERATIONS; i++)
+        downscale_argb32(k, src_data, from, from, src_stride, work, to, to,
+                         stride);
+      double ms = (now_ms() - start) / DOWNSCALE_ITERATIONS;
+
+      printf("    %-8s %8.3f ms  %5.2fx vs cairo  %s\n",
+             downscale_kernel_name(k), ms, ms > 0 ? cairo_ms / ms : 0,
+             match ? "ok" : "MISMATCH");
+    }
+
+    /* Quality check: same picture as before, give or take filtering */
+    int max_diff;
+    double psnr = image_psnr(scalar, cairo_image_surface_get_data(ref), to,
+                             to, stride, &max_diff);
+    bool close = psnr >= DOWNSCALE_MIN_PSNR;
+    if (!close)
+      rc = 1;
+    printf("    vs cairo: PSNR %.1f dB, max channel diff %d  %s\n", psnr,
+           max_diff, close ? "ok" : "TOO DIFFERENT");
+
+    free(scalar);
+    free(work);
+    cairo_surface_destroy(src);
+    cairo_surface_destroy(ref);
+  }
+  return rc;
+}
+
+/* --- Card titles --- */
+
+#define TITLE_COUNT 100
+
+static const char *const title_words[] = {
+    "README.md", "Inbox", "Firefox", "kitty", "main.c", "Résumé",
+    "Обзор", "Δοκιμή", "build", "— Visual Studio Code", "Slack",
+    "notes.txt",
+};
+
+#define NUM_TITLE_WORDS (int)(sizeof(title_words) / sizeof(title_words[0]))
+
+static void make_title(char *title, size_t size, int i) {
+  snprintf(title, size, "%s %d - %s (%s)", title_words[i % NUM_TITLE_WORDS],
+           i, title_words[(i * 7 + 3) % NUM_TITLE_WORDS],
+           title_words[(i * 5 + 1) % NUM_TITLE_WORDS]);
+}
+
+/* Time TITLE_COUNT titles drawn with Pango or the atlas into surface,
+ * in microseconds per title; -1 if the atlas refused one */
+static double draw_titles(cairo_surface_t *surface, bool atlas,
+                          const Config *cfg, int width, int size) {
+  cairo_t *cr = cairo_create(surface);
+  double r, g, b;
+  color_to_rgb(cfg->text_color, &r, &g, &b);
+
+  double total = 0;
+  for (int i = 0; i < TITLE_COUNT; i++) {
+    char title[160];
+    make_title(title, sizeof(title), i);
+    cairo_save(cr);
+    cairo_translate(cr, 0, i * 20);
+
+    double start = now_ms();
+    if (atlas) {
+      if (!glyph_atlas_draw_title(cr, title, 10, 0, width, size,
+                                  cfg->text_color)) {
+        cairo_restore(cr);
+        cairo_destroy(cr);
+        return -1;
+      }
+    } else {
+      /* First show: nothing shaped yet */
+      text_invalidate(title);
+      PangoLayout *layout = text_title_layout(title, width, size);
+      cairo_set_source_rgb(cr, r, g, b);
+      cairo_move_to(cr, 10, 0);
+      pango_cairo_show_layout(cr, layout);
+    }
+    total += now_ms() - start;
+    cairo_restore(cr);
+  }
+
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+  return total * 1000.0 / TITLE_COUNT;
+}
+
+static int bench_titles(void) {
+  Config *cfg = get_default_config();
+  if (!cfg)
+    return 1;
+  text_update(cfg);
+  int width = cfg->card_width - 20;
+  int size = cfg->title_size * PANGO_SCALE;
+  int height = TITLE_COUNT * 20;
+
+  cairo_surface_t *pango =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width + 20, height);
+  cairo_surface_t *atlas =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width + 20, height);
+
+  printf("titles: %d first-show titles, %dpx wide, Pango vs glyph atlas\n",
+         TITLE_COUNT, width);
+
+  /* Untimed pass so fonts are loaded for both */
+  draw_titles(pango, false, cfg, width, size);
+  double pango_us = draw_titles(pango, false, cfg, width, size);
+
+  glyph_atlas_cleanup();
+  double cold_us = draw_titles(atlas, true, cfg, width, size);
+  double warm_us = draw_titles(atlas, true, cfg, width, size);
+
+  int rc = 0;
+  if (cold_us < 0 || warm_us < 0) {
+    printf("  atlas refused a title\n");
+    rc = 1;
+  } else {
+    printf("  %-14s %8.2f us/title\n", "pango", pango_us);
+    printf("  %-14s %8.2f us/title  %5.2fx\n", "atlas (cold)", cold_us,
+           cold_us > 0 ? pango_us / cold_us : 0);
+    printf("  %-14s %8.2f us/title  %5.2fx\n", "atlas (warm)", warm_us,
+           warm_us > 0 ? pango_us / warm_us : 0);
+
+    /* Both surfaces got every title drawn twice over the same pixels */
+    int max_diff;
+    double psnr = image_psnr(cairo_image_surface_get_data(pango),
+                             cairo_image_surface_get_data(atlas),
+                             width + 20, height,
+                             cairo_image_surface_get_stride(pango),
+                             &max_diff);
+    printf("  vs pango: PSNR %.1f dB, max channel diff %d\n", psnr,
+           max_diff);
+  }
+
+  cairo_surface_destroy(pango);
+  cairo_surface_destroy(atlas);
+  glyph_atlas_cleanup();
+  text_cleanup();
+  free_config(cfg);
+  return rc;
+}
+
+/* --- Compositing engines --- */
+
+#define ENGINES_ITERATIONS 20
+#define ENGINES_ROWS 4 /* Leaves a scrollbar for the larger lists */
+
+/* Warm-cache frames on one thread: only compositing is left to time */
+static double composite_ms(Config *cfg, RenderEngine type, AppState *state,
+                           unsigned char *data, uint32_t width,
+                           uint32_t height) {
+  cfg->render_engine = type;
+  render_set_config(cfg);
+  render_to_memory(state, data, width, height, width * 4);
+
+  double total = 0;
+  for (int i = 0; i < ENGINES_ITERATIONS; i++)
+    total += render_to_memory(state, data, width, height, width * 4);
+  return total / ENGINES_ITERATIONS;
+}
+
+static int bench_engines(void) {
+  Config *cfg = get_default_config();
+  if (!cfg)
+    return 1;
+  cfg->max_cols = TILES_COLS;
+  cfg->max_rows = ENGINES_ROWS;
+  cfg->render_threads = 1;
+  icons_init(cfg->icon_theme, cfg->icon_fallback);
+
+  printf("engines: warm-cache frames, %d columns, Cairo vs pixman\n",
+         TILES_COLS);
+
+  int rc = 0;
+  for (size_t n = 0; n < sizeof(tile_window_counts) / sizeof(int); n++) {
+    AppState state;
+    app_state_init(&state);
+    if (fill_windows(&state, tile_window_counts[n]) < 0) {
+      app_state_free(&state);
+      rc = 1;
+      break;
+    }
+    state.selected_index = 1; /* Card shadow and selected chrome */
+
+    render_set_config(cfg);
+    uint32_t width, height;
+    calculate_dimensions(&state, &width, &height);
+    size_t size = (size_t)width * height * 4;
+    unsigned char *cairo = malloc(size);
+    unsigned char *pixman = malloc(size);
+    if (!cairo || !pixman) {
+      free(cairo);
+      free(pixman);
+      app_state_free(&state);
+      rc = 1;
+      break;
+    }
+
+    double cairo_ms = composite_ms(cfg, RENDER_ENGINE_CAIRO, &state, cairo,
+                                   width, height);
+    double pixman_ms = composite_ms(cfg, RENDER_ENGINE_PIXMAN, &state,
+                                    pixman, width, height);
+
+    /* Scrollbar edges are snapped to whole pixels by pixman */
+    int max_diff;
+    double psnr = image_psnr(cairo, pixman, width, height, width * 4,
+                             &max_diff);
+    printf("  %3d windows  %4ux%-5u cairo %8.3f ms  pixman %8.3f ms  "
+           "%5.2fx  PSNR %.1f dB, max diff %d\n",
+           tile_window_counts[n], width, height, cairo_ms, pixman_ms,
+           pixman_ms > 0 ? cairo_ms / pixman_ms : 0, psnr, max_diff);
+
+    free(cairo);
+    free(pixman);
+    app_state_free(&state);
+  }
+
+  render_cleanup();
+  icons_cleanup();
+  free_config(cfg);
+  return rc;
+}
+
+static const struct {
+  const char *name;
+  BenchFn fn;
+} benchmarks[] = {
+    {"blur", bench_blur},
+    {"tiles", bench_tiles},
+    {"downscale", bench_downscale},
+    {"titles", bench_titles},
+    {"engines", bench_engines},
+};
+
+#define NUM_BENCHMARKS (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+int bench_run(const char *name) {
+  int rc = 0;
+  bool found = false;
+
+  for (int i = 0; i < NUM_BENCHMARKS; i++) {
+    if (strcmp(name, "all") != 0 && strcmp(name, benchmarks[i].name) != 0)
+      continue;
+    found = true;
+    if (benchmarks[i].fn() != 0)
+      rc = 1;
+  }
+
+  if (!found) {
+    fprintf(stderr, "Unknown benchmark: %s (available:", name);
+    for (int i = 0; i < NUM_BENCHMARKS; i++)
+      fprintf(stderr, " %s", benchmarks[i].name);
+    fprintf(stderr, " all)\n");
+    return 1;
+  }
+  return rc;
+}
@@ -0,0 +1,9 @@
+/* src/bench.h - Built-in Micro-benchmarks */
+#ifndef BENCH_H
+#define BENCH_H
+
+/* Run a named benchmark (or "all") and print results to stdout.
+ * Returns 0 on success, 1 on an unknown name or failed check. */
+int bench_run(const char *name);
+
+#endif /* BENCH_H */
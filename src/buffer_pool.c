@@ -0,0 +1,166 @@
+/* src/buffer_pool.c - Persistent wl_shm Buffer Pool */
+#define _GNU_SOURCE
+
+#include "buffer_pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Buffers] " fmt "\n", ##__VA_ARGS__)
+
+/* Bytes per pixel for WL_SHM_FORMAT_ARGB8888 */
+#define BYTES_PER_PIXEL 4
+
+int create_shm_file(off_t size) {
+  int fd = -1;
+
+#ifdef MFD_CLOEXEC
+  fd = memfd_create("wswitch-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd >= 0) {
+    if (ftruncate(fd, size) < 0) {
+      close(fd);
+      return -1;
+    }
+    /* The compositor maps this too: never let it shrink under them */
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK);
+    return fd;
+  }
+  LOG("memfd_create failed (%s), falling back to /tmp", strerror(errno));
+#endif
+
+  char name[] = "/tmp/wswitch-shm-XXXXXX";
+  fd = mkstemp(name);
+  if (fd < 0)
+    return -1;
+  unlink(name);
+  if (ftruncate(fd, size) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void buffer_release(void *data, struct wl_buffer *wl_buffer) {
+  (void)wl_buffer;
+  ShmBuffer *buf = (ShmBuffer *)data;
+  buf->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = buffer_release,
+};
+
+static void buffer_destroy(ShmBuffer *buf) {
+  if (buf->wl_buffer)
+    wl_buffer_destroy(buf->wl_buffer);
+  if (buf->shm_pool)
+    wl_shm_pool_destroy(buf->shm_pool);
+  if (buf->data)
+    munmap(buf->data, buf->capacity);
+  if (buf->fd >= 0)
+    close(buf->fd);
+  memset(buf, 0, sizeof(ShmBuffer));
+  buf->fd = -1;
+}
+
+/* Make sure the buffer's mapping can hold size bytes */
+static int buffer_reserve(BufferPool *pool, ShmBuffer *buf, size_t size) {
+  if (buf->data && buf->capacity >= size)
+    return 0;
+
+  if (buf->fd < 0) {
+    buf->fd = create_shm_file(size);
+    if (buf->fd < 0) {
+      LOG("Failed to create shm file (%zu bytes)", size);
+      return -1;
+    }
+    buf->shm_pool = wl_shm_create_pool(pool->shm, buf->fd, size);
+  } else {
+    /* Grow: wl_shm_pool can only get larger, which is all we ever need */
+    if (ftruncate(buf->fd, size) < 0) {
+      LOG("Failed to grow shm file: %s", strerror(errno));
+      return -1;
+    }
+    wl_shm_pool_resize(buf->shm_pool, size);
+    munmap(buf->data, buf->capacity);
+    buf->data = NULL;
+  }
+
+  void *data =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buf->fd, 0);
+  if (data == MAP_FAILED) {
+    LOG("mmap failed: %s", strerror(errno));
+    buffer_destroy(buf);
+    return -1;
+  }
+
+  buf->data = data;
+  buf->capacity = size;
+  LOG("Buffer %p mapped %zu KiB", (void *)buf, size / 1024);
+  return 0;
+}
+
+void buffer_pool_init(BufferPool *pool, struct wl_shm *shm) {
+  memset(pool, 0, sizeof(BufferPool));
+  pool->shm = shm;
+  for (int i = 0; i < BUFFER_POOL_SIZE; i++)
+    pool->buffers[i].fd = -1;
+}
+
+ShmBuffer *buffer_pool_acquire(BufferPool *pool, uint32_t width,
+                               uint32_t height) {
+  if (!pool->shm || width == 0 || height == 0)
+    return NULL;
+
+  /* Prefer a free buffer that already has the right size, then any free
+   * buffer with memory, then an unused slot */
+  ShmBuffer *buf = NULL;
+  for (int i = 0; i < BUFFER_POOL_SIZE; i++) {
+    ShmBuffer *b = &pool->buffers[i];
+    if (b->busy)
+      continue;
+    if (b->wl_buffer && b->width == width && b->height == height)
+      return b;
+    if (!buf || (!buf->data && b->data))
+      buf = b;
+  }
+
+  if (!buf) {
+    LOG("All %d buffers are held by the compositor", BUFFER_POOL_SIZE);
+    return NULL;
+  }
+
+  int stride = (int)width * BYTES_PER_PIXEL;
+  size_t size = (size_t)stride * height;
+
+  if (buffer_reserve(pool, buf, size) < 0)
+    return NULL;
+
+  /* The wl_buffer describes fixed dimensions; recreating it is cheap and
+   * leaves the mapping untouched */
+  if (buf->wl_buffer)
+    wl_buffer_destroy(buf->wl_buffer);
+  buf->wl_buffer = wl_shm_pool_create_buffer(
+      buf->shm_pool, 0, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+  wl_buffer_add_listener(buf->wl_buffer, &buffer_listener, buf);
+
+  buf->width = width;
+  buf->height = height;
+  buf->stride = stride;
+  buf->content_serial = 0;
+  return buf;
+}
+
+void buffer_pool_mark_busy(ShmBuffer *buf) {
+  if (buf)
+    buf->busy = true;
+}
+
+void buffer_pool_finish(BufferPool *pool) {
+  for (int i = 0; i < BUFFER_POOL_SIZE; i++)
+    buffer_destroy(&pool->buffers[i]);
+}
@@ -0,0 +1,57 @@
+/* src/buffer_pool.h - Persistent wl_shm Buffer Pool */
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-client.h>
+
+/* Number of buffers kept alive (triple buffering) */
+#define BUFFER_POOL_SIZE 3
+
+/* A single shm-backed buffer, reused across frames */
+typedef struct {
+  struct wl_buffer *wl_buffer;  /* NULL until first use */
+  struct wl_shm_pool *shm_pool; /* Pool owning this buffer's memory */
+  int fd;                       /* memfd backing the pool */
+  void *data;                   /* Mapped pixels */
+  size_t capacity;              /* Mapped size in bytes (only grows) */
+  uint32_t width;
+  uint32_t height;
+  int stride;
+  bool busy; /* Attached and not yet released by the compositor */
+
+  /* What the renderer last drew here, so a frame can be patched in place.
+   * content_serial is reset to 0 whenever the pixels become undefined. */
+  uint32_t content_serial;
+  int content_selected;
+  int content_fade_from; /* Card still fading out in this frame, or -1 */
+  int content_first_row; /* Grid row at the top of the scrolled view */
+  int content_quality;   /* Render quality tier it was drawn at */
+} ShmBuffer;
+
+typedef struct {
+  struct wl_shm *shm;
+  ShmBuffer buffers[BUFFER_POOL_SIZE];
+} BufferPool;
+
+/* Create a shared memory file for Wayland buffers */
+int create_shm_file(off_t size);
+
+/* Initialize an empty pool (no memory is allocated until acquire) */
+void buffer_pool_init(BufferPool *pool, struct wl_shm *shm);
+
+/* Get a buffer the compositor does not hold, sized to width x height.
+ * Memory is reused and only grows. Returns NULL if every buffer is busy. */
+ShmBuffer *buffer_pool_acquire(BufferPool *pool, uint32_t width,
+                               uint32_t height);
+
+/* Mark a buffer as attached; it stays busy until wl_buffer.release */
+void buffer_pool_mark_busy(ShmBuffer *buf);
+
+/* Destroy all buffers and unmap their memory */
+void buffer_pool_finish(BufferPool *pool);
+
+#endif /* BUFFER_POOL_H */
@@ -0,0 +1,137 @@
+/* src/card_cache.c - Pre-rasterized Card Cache */
+#define _POSIX_C_SOURCE 200809L
+
+#include "card_cache.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Cards] " fmt "\n", ##__VA_ARGS__)
+#define MAX_CARDS 128
+
+/* A card is identified by everything draw_card() reads from the window */
+typedef struct {
+  char *identifier;
+  char *title;
+  char *class_name;
+  int group_count;
+  bool selected;
+  uint32_t scale120; /* Output scale the card was rasterized for */
+  cairo_surface_t *surface;
+  unsigned long access_time; /* LRU timestamp */
+} CardCacheEntry;
+
+/* Render thread, apart from the counters: the main thread reads those for
+ * its logs while frames are drawn */
+static CardCacheEntry card_cache[MAX_CARDS];
+static _Atomic int cache_count = 0;
+static unsigned long lru_counter = 0;
+static _Atomic unsigned long hits = 0;
+static _Atomic unsigned long misses = 0;
+
+static const char *str_or_empty(const char *s) { return s ? s : ""; }
+
+static bool entry_matches(const CardCacheEntry *e, const WindowInfo *win,
+                          bool selected, uint32_t scale120) {
+  return e->selected == selected && e->scale120 == scale120 &&
+         e->group_count == win->group_count &&
+         strcmp(e->identifier, str_or_empty(win->address)) == 0 &&
+         strcmp(e->title, str_or_empty(win->title)) == 0 &&
+         strcmp(e->class_name, str_or_empty(win->class_name)) == 0;
+}
+
+static void entry_free(CardCacheEntry *e) {
+  free(e->identifier);
+  free(e->title);
+  free(e->class_name);
+  if (e->surface)
+    cairo_surface_destroy(e->surface);
+  memset(e, 0, sizeof(CardCacheEntry));
+}
+
+/* Remove entry i by moving the last entry into its slot */
+static void remove_entry(int i) {
+  entry_free(&card_cache[i]);
+  if (i < cache_count - 1) {
+    card_cache[i] = card_cache[cache_count - 1];
+    memset(&card_cache[cache_count - 1], 0, sizeof(CardCacheEntry));
+  }
+  cache_count--;
+}
+
+static void evict_lru_entry(void) {
+  int lru_index = 0;
+  for (int i = 1; i < cache_count; i++) {
+    if (card_cache[i].access_time < card_cache[lru_index].access_time)
+      lru_index = i;
+  }
+  remove_entry(lru_index);
+}
+
+cairo_surface_t *card_cache_lookup(const WindowInfo *win, bool selected,
+                                   uint32_t scale120) {
+  for (int i = 0; i < cache_count; i++) {
+    if (entry_matches(&card_cache[i], win, selected, scale120)) {
+      card_cache[i].access_time = ++lru_counter;
+      hits++;
+      return card_cache[i].surface;
+    }
+  }
+  misses++;
+  return NULL;
+}
+
+void card_cache_store(const WindowInfo *win, bool selected, uint32_t scale120,
+                      cairo_surface_t *surface) {
+  if (!surface)
+    return;
+
+  if (cache_count >= MAX_CARDS)
+    evict_lru_entry();
+
+  CardCacheEntry *e = &card_cache[cache_count];
+  e->identifier = strdup(str_or_empty(win->address));
+  e->title = strdup(str_or_empty(win->title));
+  e->class_name = strdup(str_or_empty(win->class_name));
+  if (!e->identifier || !e->title || !e->class_name) {
+    entry_free(e);
+    return;
+  }
+  e->group_count = win->group_count;
+  e->selected = selected;
+  e->scale120 = scale120;
+  e->surface = cairo_surface_reference(surface);
+  e->access_time = ++lru_counter;
+  cache_count++;
+}
+
+void card_cache_invalidate(const char *identifier) {
+  if (!identifier)
+    return;
+  for (int i = cache_count - 1; i >= 0; i--) {
+    if (strcmp(card_cache[i].identifier, identifier) == 0)
+      remove_entry(i);
+  }
+}
+
+void card_cache_clear(void) {
+  for (int i = 0; i < cache_count; i++)
+    entry_free(&card_cache[i]);
+  cache_count = 0;
+  lru_counter = 0;
+}
+
+void card_cache_get_stats(unsigned long *h, unsigned long *m) {
+  if (h)
+    *h = hits;
+  if (m)
+    *m = misses;
+}
+
+void card_cache_log_stats(void) {
+  unsigned long h = hits, m = misses;
+  unsigned long total = h + m;
+  LOG("%lu hits, %lu misses (%.1f%% composited), %d cached", h, m,
+      total ? 100.0 * h / total : 0.0, (int)cache_count);
+}
@@ -0,0 +1,32 @@
+/* src/card_cache.h - Pre-rasterized Card Cache */
+#ifndef CARD_CACHE_H
+#define CARD_CACHE_H
+
+#include "data.h"
+#include <cairo/cairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Look up a card rendered at an output scale in 1/120 units (borrowed
+ * reference, NULL on miss) */
+cairo_surface_t *card_cache_lookup(const WindowInfo *win, bool selected,
+                                   uint32_t scale120);
+
+/* Store a rendered card; the cache takes its own reference, or none if
+ * out of memory */
+void card_cache_store(const WindowInfo *win, bool selected, uint32_t scale120,
+                      cairo_surface_t *surface);
+
+/* Drop every card rendered for a window (title or app_id changed) */
+void card_cache_invalidate(const char *identifier);
+
+/* Drop all cards (config changed) */
+void card_cache_clear(void);
+
+/* Lookup counters since startup (any thread) */
+void card_cache_get_stats(unsigned long *hits, unsigned long *misses);
+
+/* Log the hit rate (any thread) */
+void card_cache_log_stats(void);
+
+#endif /* CARD_CACHE_H */
@@ -15,6 +15,7 @@
 static void set_defaults(Config *cfg) {
   cfg->mode = MODE_CONTEXT;
   cfg->follow_monitor = true;
+  strncpy(cfg->output, "auto", sizeof(cfg->output) - 1);
 
   /* Default Theme Colors */
   cfg->background = 0x1e1e2e;
@@ -25,6 +26,7 @@ static void set_defaults(Config *cfg) {
   cfg->border_color = 0x89b4fa;
   cfg->border_width = 2;
   cfg->card_radius = 12;
+  cfg->shadow_size = 12;
 
   /* Layout */
   cfg->card_width = 160;
@@ -32,6 +34,10 @@ static void set_defaults(Config *cfg) {
   cfg->card_gap = 10;
   cfg->padding = 20;
   cfg->max_cols = 5;
+  cfg->max_rows = 4;
+  cfg->list_width = 480;
+  cfg->list_row_height = 32;
+  cfg->list_rows = 12;
 
   /* Icons */
   cfg->icon_size = 56;
@@ -46,6 +52,23 @@ static void set_defaults(Config *cfg) {
   strncpy(cfg->font_family, "Sans", sizeof(cfg->font_family) - 1);
   strncpy(cfg->font_weight, "Bold", sizeof(cfg->font_weight) - 1);
   cfg->title_size = 10;
+  cfg->title_engine = TEXT_ENGINE_PANGO;
+
+  /* Animation */
+  cfg->animation_duration = 120;
+  cfg->selection_layer = false;
+  cfg->debug_hud = false;
+
+  /* Rendering */
+  cfg->render_threads = 0;
+  cfg->render_engine = RENDER_ENGINE_CAIRO;
+  cfg->frame_budget_ms = 0;
+
+  /* Thumbnails */
+  cfg->thumbnails = false;
+  cfg->thumbnail_captures = 2;
+  cfg->thumbnail_memory_mb = 32;
+  cfg->thumbnail_refresh_ms = 2000;
 }
 
 /* --- Hex Color Helper --- */
@@ -81,9 +104,30 @@ static void apply_value(Config *cfg, const char *section, const char *key,
         cfg->mode = MODE_CONTEXT;
       else if (strcasecmp(val, "overview") == 0)
         cfg->mode = MODE_OVERVIEW;
+      else if (strcasecmp(val, "list") == 0)
+        cfg->mode = MODE_LIST;
     } else if (strcasecmp(key, "follow_monitor") == 0) {
       cfg->follow_monitor =
           (strcasecmp(val, "true") == 0 || strcmp(val, "1") == 0);
+    } else if (strcasecmp(key, "output") == 0) {
+      strncpy(cfg->output, val, sizeof(cfg->output) - 1);
+    } else if (strcasecmp(key, "animation_duration") == 0) {
+      cfg->animation_duration = atoi(val);
+    } else if (strcasecmp(key, "selection_layer") == 0) {
+      cfg->selection_layer =
+          (strcasecmp(val, "true") == 0 || strcmp(val, "1") == 0);
+    } else if (strcasecmp(key, "debug_hud") == 0) {
+      cfg->debug_hud =
+          (strcasecmp(val, "true") == 0 || strcmp(val, "1") == 0);
+    } else if (strcasecmp(key, "render_threads") == 0) {
+      cfg->render_threads = atoi(val);
+    } else if (strcasecmp(key, "render_engine") == 0) {
+      if (strcasecmp(val, "pixman") == 0)
+        cfg->render_engine = RENDER_ENGINE_PIXMAN;
+      else if (strcasecmp(val, "cairo") == 0)
+        cfg->render_engine = RENDER_ENGINE_CAIRO;
+    } else if (strcasecmp(key, "frame_budget_ms") == 0) {
+      cfg->frame_budget_ms = atof(val);
     }
   }
   /* Colors (from theme or manual override) */
@@ -105,6 +149,8 @@ static void apply_value(Config *cfg, const char *section, const char *key,
       cfg->border_width = atoi(val);
     else if (strcasecmp(key, "corner_radius") == 0)
       cfg->card_radius = atoi(val);
+    else if (strcasecmp(key, "shadow_size") == 0)
+      cfg->shadow_size = atoi(val);
   }
   /* Layout */
   else if (strcasecmp(section, "layout") == 0) {
@@ -118,10 +164,18 @@ static void apply_value(Config *cfg, const char *section, const char *key,
       cfg->padding = atoi(val);
     else if (strcasecmp(key, "max_cols") == 0)
       cfg->max_cols = atoi(val);
+    else if (strcasecmp(key, "max_rows") == 0)
+      cfg->max_rows = atoi(val);
     else if (strcasecmp(key, "icon_size") == 0)
       cfg->icon_size = atoi(val);
     else if (strcasecmp(key, "icon_radius") == 0)
       cfg->icon_radius = atoi(val);
+    else if (strcasecmp(key, "list_width") == 0)
+      cfg->list_width = atoi(val);
+    else if (strcasecmp(key, "list_row_height") == 0)
+      cfg->list_row_height = atoi(val);
+    else if (strcasecmp(key, "list_rows") == 0)
+      cfg->list_rows = atoi(val);
   }
   /* Icons */
   else if (strcasecmp(section, "icons") == 0) {
@@ -133,6 +187,18 @@ static void apply_value(Config *cfg, const char *section, const char *key,
       cfg->show_letter_fallback =
           (strcasecmp(val, "true") == 0 || strcmp(val, "1") == 0);
   }
+  /* Thumbnails */
+  else if (strcasecmp(section, "thumbnails") == 0) {
+    if (strcasecmp(key, "enabled") == 0)
+      cfg->thumbnails =
+          (strcasecmp(val, "true") == 0 || strcmp(val, "1") == 0);
+    else if (strcasecmp(key, "max_captures") == 0)
+      cfg->thumbnail_captures = atoi(val);
+    else if (strcasecmp(key, "memory_mb") == 0)
+      cfg->thumbnail_memory_mb = atoi(val);
+    else if (strcasecmp(key, "refresh_ms") == 0)
+      cfg->thumbnail_refresh_ms = atoi(val);
+  }
   /* Font */
   else if (strcasecmp(section, "font") == 0) {
     if (strcasecmp(key, "family") == 0)
@@ -143,6 +209,12 @@ static void apply_value(Config *cfg, const char *section, const char *key,
       cfg->title_size = atoi(val);
     else if (strcasecmp(key, "icon_letter_size") == 0)
       cfg->icon_letter_size = atoi(val);
+    else if (strcasecmp(key, "title_engine") == 0) {
+      if (strcasecmp(val, "atlas") == 0)
+        cfg->title_engine = TEXT_ENGINE_ATLAS;
+      else if (strcasecmp(val, "pango") == 0)
+        cfg->title_engine = TEXT_ENGINE_PANGO;
+    }
   }
 }
 
@@ -323,6 +395,14 @@ Config *get_default_config(void) {
   return cfg;
 }
 
+int config_load_theme(Config *cfg, const char *theme) {
+  if (!theme)
+    return -1;
+  if (access(theme, R_OK) == 0)
+    return parse_ini_file(theme, cfg, NULL, 0);
+  return load_theme(theme, cfg);
+}
+
 void free_config(Config *cfg) { free(cfg); }
 
 void color_to_rgb(uint32_t color, double *r, double *g, double *b) {
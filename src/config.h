@@ -8,9 +8,22 @@
 /* View mode for window display */
 typedef enum {
   MODE_OVERVIEW, /* Show all windows individually */
-  MODE_CONTEXT   /* Group tiled windows by workspace + app class */
+  MODE_CONTEXT,  /* Group tiled windows by workspace + app class */
+  MODE_LIST      /* One text row per window instead of cards */
 } ViewMode;
 
+/* How card titles are drawn */
+typedef enum {
+  TEXT_ENGINE_PANGO, /* Shape every title with Pango */
+  TEXT_ENGINE_ATLAS  /* Glyph atlas for simple scripts, Pango for the rest */
+} TextEngine;
+
+/* How frames are assembled from sprites and cached cards */
+typedef enum {
+  RENDER_ENGINE_CAIRO, /* Cairo for everything */
+  RENDER_ENGINE_PIXMAN /* Pixman for blits and flat shapes, Cairo for text */
+} RenderEngine;
+
 /* Theme configuration */
 typedef struct {
   /* Colors (0xRRGGBB) */
@@ -20,6 +33,7 @@ typedef struct {
   uint32_t border_color;
   uint32_t text_color;
   uint32_t subtext_color;
+  int shadow_size; /* Blur of panel and selected card shadows (0 = none) */
 
   /* Layout */
   int card_width;
@@ -29,14 +43,21 @@ typedef struct {
   int border_width;
   int padding;
   int max_cols;
+  int max_rows; /* Visible rows before the grid scrolls (0 = unlimited) */
   int icon_size;
   int icon_radius;
 
+  /* List mode */
+  int list_width;
+  int list_row_height;
+  int list_rows; /* Visible rows before the list scrolls (0 = unlimited) */
+
   /* Typography */
   char font_family[64];
   char font_weight[32];
   int title_size;
   int icon_letter_size;
+  TextEngine title_engine;
 
   /* Icons */
   char icon_theme[64];
@@ -46,6 +67,34 @@ typedef struct {
   /* View Mode */
   bool follow_monitor;
   ViewMode mode;
+
+  /* Output the panel opens on: "auto" (compositor's choice), "focused"
+   * (the active window's) or a connector name such as "DP-1" */
+  char output[32];
+
+  /* Draw the selection on its own subsurface, so moving it needs no
+   * repaint (no cross-fade or card shadow then) */
+  bool selection_layer;
+
+  /* Frame, cache and buffer numbers drawn over the panel */
+  bool debug_hud;
+
+  /* Selection cross-fade length in ms (0 = instant) */
+  int animation_duration;
+
+  /* Threads rasterizing a full repaint (0 = one per core, 1 = serial) */
+  int render_threads;
+  RenderEngine render_engine;
+
+  /* Full repaints over this many ms lower the render quality a tier at a
+   * time; it comes back once they are fast again (0 = always best) */
+  double frame_budget_ms;
+
+  /* Live window previews in place of icons */
+  bool thumbnails;
+  int thumbnail_captures;   /* Captures in flight at once */
+  int thumbnail_memory_mb;  /* Budget for finished thumbnails */
+  int thumbnail_refresh_ms; /* Minimum time between captures of a window */
 } Config;
 
 /* Load config from file, returns default if file not found */
@@ -57,6 +106,10 @@ void free_config(Config *config);
 /* Get default config (fallback values) */
 Config *get_default_config(void);
 
+/* Apply a theme on top of config: a path to an .ini file, or a theme name
+ * looked up like [theme] name. Returns -1 if it was not found. */
+int config_load_theme(Config *config, const char *theme);
+
 /* Helper: Convert uint32_t hex color to cairo RGB (0.0-1.0) */
 void color_to_rgb(uint32_t color, double *r, double *g, double *b);
 
@@ -12,6 +12,8 @@ void app_state_init(AppState *state) {
   state->selected_index = 0;
   state->width = 200; /* Default safe size */
   state->height = 100;
+  state->columns = 0;
+  state->visible_rows = 0;
 }
 int app_state_add(AppState *state, WindowInfo *info) {
   if (state->count >= state->capacity) {
@@ -25,6 +27,33 @@ int app_state_add(AppState *state, WindowInfo *info) {
   state->windows[state->count++] = *info;
   return 0;
 }
+
+static char *dup_or_null(const char *s) { return s ? strdup(s) : NULL; }
+
+int app_state_copy(AppState *dst, const AppState *src) {
+  dst->selected_index = src->selected_index;
+  dst->width = src->width;
+  dst->height = src->height;
+  dst->columns = src->columns;
+  dst->visible_rows = src->visible_rows;
+
+  for (int i = 0; i < src->count; i++) {
+    const WindowInfo *w = &src->windows[i];
+    WindowInfo copy = *w;
+    copy.address = dup_or_null(w->address);
+    copy.title = dup_or_null(w->title);
+    copy.class_name = dup_or_null(w->class_name);
+    if ((w->address && !copy.address) || (w->title && !copy.title) ||
+        (w->class_name && !copy.class_name) ||
+        app_state_add(dst, &copy) < 0) {
+      window_info_free(&copy);
+      app_state_free(dst);
+      return -1;
+    }
+  }
+  return 0;
+}
+
 void app_state_free(AppState *state) {
   if (state) {
     if (state->windows) {
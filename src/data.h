@@ -27,6 +27,8 @@ typedef struct {
   /* UI Dimensions (Shared with Input/Render) */
   uint32_t width;
   uint32_t height;
+  int columns;      /* Grid shape picked with the size (0 = not yet) */
+  int visible_rows; /* Rows in view before the grid scrolls */
 } AppState;
 
 /* Initialize AppState */
@@ -34,6 +36,10 @@ void app_state_init(AppState *state);
 
 int app_state_add(AppState *state, WindowInfo *info);
 
+/* Deep-copy windows, selection, size and grid shape into an initialized
+ * dst. Returns 0 on success, -1 if out of memory (dst is left empty). */
+int app_state_copy(AppState *dst, const AppState *src);
+
 /* Free all resources held by AppState */
 void app_state_free(AppState *state);
 
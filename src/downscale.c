@@ -0,0 +1,350 @@
+/* src/downscale.c - Area-averaging Image Downscaler
+ *
+ * Icon themes ship large PNGs that are shrunk once per size. The filter
+ * is a separable box with exact fractional coverage, in 14-bit fixed
+ * point. The vertical pass runs first: it touches every source pixel, so
+ * it is the one worth vectorizing, and it leaves only output rows for the
+ * horizontal pass. Intermediate rows keep 7 fractional bits as int16,
+ * which lets both passes use 16-bit multiply-add (pmaddwd) and keeps all
+ * kernels bit-exact.
+ */
+#include "downscale.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#define LOG(fmt, ...) fprintf(stderr, "[Downscale] " fmt "\n", ##__VA_ARGS__)
+
+/* Weights sum to 1 << WEIGHT_BITS */
+#define WEIGHT_BITS 14
+/* Fractional bits kept between the passes: 255 << 7 fits int16 */
+#define MID_BITS 7
+#define MID_SHIFT (WEIGHT_BITS - MID_BITS)
+#define OUT_SHIFT (WEIGHT_BITS + MID_BITS)
+
+/* Source taps of every output pixel along one axis */
+typedef struct {
+  int *start;  /* First source index */
+  int *count;  /* Taps actually covered */
+  int16_t *w;  /* taps weights per output, zero-padded */
+  int taps;    /* Even, so SIMD kernels can always take taps in pairs */
+} Filter;
+
+static void filter_free(Filter *f) {
+  free(f->start);
+  free(f->count);
+  free(f->w);
+}
+
+static int filter_build(Filter *f, int src, int dst) {
+  double scale = (double)src / dst;
+  f->taps = ((int)ceil(scale) + 2) & ~1;
+  f->start = malloc(dst * sizeof(int));
+  f->count = malloc(dst * sizeof(int));
+  f->w = calloc((size_t)dst * f->taps, sizeof(int16_t));
+  if (!f->start || !f->count || !f->w)
+    return -1;
+
+  for (int o = 0; o < dst; o++) {
+    double lo = o * scale;
+    double hi = (o + 1) * scale;
+    int first = (int)floor(lo);
+    int last = (int)ceil(hi) - 1;
+    if (last > src - 1)
+      last = src - 1;
+
+    int16_t *w = f->w + (size_t)o * f->taps;
+    int total = 0;
+    int largest = 0;
+    for (int i = first; i <= last; i++) {
+      double cover = fmin(hi, i + 1) - fmax(lo, i);
+      int k = i - first;
+      w[k] = (int16_t)lround(cover / scale * (1 << WEIGHT_BITS));
+      total += w[k];
+      if (w[k] > w[largest])
+        largest = k;
+    }
+    /* Rounding must not change overall brightness */
+    w[largest] += (1 << WEIGHT_BITS) - total;
+
+    f->start[o] = first;
+    f->count[o] = last - first + 1;
+  }
+  return 0;
+}
+
+/* One output row of the vertical pass: mid = sum of w[k] * rows[k] over
+ * len bytes, rounded to MID_BITS fractional bits. rows has an even number
+ * of entries; padding entries have weight 0. */
+typedef void (*VerticalFn)(const uint8_t *const *rows, const int16_t *w,
+                           int taps, int16_t *mid, int len);
+
+/* One output row of the horizontal pass over ARGB pixels of mid */
+typedef void (*HorizontalFn)(const int16_t *mid, const Filter *f,
+                             uint8_t *dst, int dst_w);
+
+static inline void vertical_scalar_span(const uint8_t *const *rows,
+                                        const int16_t *w, int taps,
+                                        int16_t *mid, int from, int to) {
+  for (int i = from; i < to; i++) {
+    int32_t acc = 0;
+    for (int k = 0; k < taps; k++)
+      acc += w[k] * rows[k][i];
+    mid[i] = (int16_t)((acc + (1 << (MID_SHIFT - 1))) >> MID_SHIFT);
+  }
+}
+
+static void vertical_scalar(const uint8_t *const *rows, const int16_t *w,
+                            int taps, int16_t *mid, int len) {
+  vertical_scalar_span(rows, w, taps, mid, 0, len);
+}
+
+static inline uint8_t out_channel(int32_t acc) {
+  acc = (acc + (1 << (OUT_SHIFT - 1))) >> OUT_SHIFT;
+  return (uint8_t)(acc > 255 ? 255 : acc);
+}
+
+static void horizontal_scalar(const int16_t *mid, const Filter *f,
+                              uint8_t *dst, int dst_w) {
+  for (int o = 0; o < dst_w; o++) {
+    const int16_t *w = f->w + (size_t)o * f->taps;
+    const int16_t *p = mid + (size_t)f->start[o] * 4;
+    for (int c = 0; c < 4; c++) {
+      int32_t acc = 0;
+      for (int k = 0; k < f->count[o]; k++)
+        acc += w[k] * p[k * 4 + c];
+      dst[o * 4 + c] = out_channel(acc);
+    }
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2"))) static inline __m128i
+round_mid_sse2(__m128i acc) {
+  const __m128i half = _mm_set1_epi32(1 << (MID_SHIFT - 1));
+  return _mm_srai_epi32(_mm_add_epi32(acc, half), MID_SHIFT);
+}
+
+__attribute__((target("sse2"))) static void
+vertical_sse2(const uint8_t *const *rows, const int16_t *w, int taps,
+              int16_t *mid, int len) {
+  const __m128i zero = _mm_setzero_si128();
+  int simd_len = len & ~15;
+
+  for (int i = 0; i < simd_len; i += 16) {
+    __m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+
+    /* Interleave two rows so pmaddwd adds w[k] * a + w[k + 1] * b */
+    for (int k = 0; k < taps; k += 2) {
+      __m128i wpair = _mm_set1_epi32((int)((uint16_t)w[k] |
+                                           ((uint32_t)(uint16_t)w[k + 1]
+                                            << 16)));
+      __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + i));
+      __m128i a_lo = _mm_unpacklo_epi8(a, zero);
+      __m128i a_hi = _mm_unpackhi_epi8(a, zero);
+      __m128i b_lo = _mm_unpacklo_epi8(b, zero);
+      __m128i b_hi = _mm_unpackhi_epi8(b, zero);
+
+      acc0 = _mm_add_epi32(
+          acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), wpair));
+      acc1 = _mm_add_epi32(
+          acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), wpair));
+      acc2 = _mm_add_epi32(
+          acc2, _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), wpair));
+      acc3 = _mm_add_epi32(
+          acc3, _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), wpair));
+    }
+
+    _mm_storeu_si128((__m128i *)(mid + i),
+                     _mm_packs_epi32(round_mid_sse2(acc0),
+                                     round_mid_sse2(acc1)));
+    _mm_storeu_si128((__m128i *)(mid + i + 8),
+                     _mm_packs_epi32(round_mid_sse2(acc2),
+                                     round_mid_sse2(acc3)));
+  }
+  vertical_scalar_span(rows, w, taps, mid, simd_len, len);
+}
+
+/* Also used by the AVX2 kernel: a pixel is only four channels wide */
+__attribute__((target("sse2"))) static void
+horizontal_sse2(const int16_t *mid, const Filter *f, uint8_t *dst,
+                int dst_w) {
+  const __m128i half = _mm_set1_epi32(1 << (OUT_SHIFT - 1));
+
+  for (int o = 0; o < dst_w; o++) {
+    const int16_t *w = f->w + (size_t)o * f->taps;
+    const int16_t *p = mid + (size_t)f->start[o] * 4;
+    __m128i acc = _mm_setzero_si128();
+
+    /* Pixels k and k + 1 interleaved per channel, weighted in one go.
+     * An odd count reads one padding pixel with weight 0. */
+    for (int k = 0; k < f->count[o]; k += 2) {
+      __m128i wpair = _mm_set1_epi32((int)((uint16_t)w[k] |
+                                           ((uint32_t)(uint16_t)w[k + 1]
+                                            << 16)));
+      __m128i pk = _mm_loadl_epi64((const __m128i *)(p + k * 4));
+      __m128i pk1 = _mm_loadl_epi64((const __m128i *)(p + k * 4 + 4));
+      acc = _mm_add_epi32(acc,
+                          _mm_madd_epi16(_mm_unpacklo_epi16(pk, pk1), wpair));
+    }
+
+    acc = _mm_srai_epi32(_mm_add_epi32(acc, half), OUT_SHIFT);
+    __m128i px = _mm_packs_epi32(acc, acc);
+    px = _mm_packus_epi16(px, px);
+    uint32_t v = (uint32_t)_mm_cvtsi128_si32(px);
+    memcpy(dst + o * 4, &v, 4);
+  }
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+round_mid_avx2(__m256i acc) {
+  const __m256i half = _mm256_set1_epi32(1 << (MID_SHIFT - 1));
+  return _mm256_srai_epi32(_mm256_add_epi32(acc, half), MID_SHIFT);
+}
+
+/* Same as SSE2 at twice the width. Unpack and pack both work within
+ * 128-bit lanes, so element order survives the round trip. */
+__attribute__((target("avx2"))) static void
+vertical_avx2(const uint8_t *const *rows, const int16_t *w, int taps,
+              int16_t *mid, int len) {
+  int simd_len = len & ~31;
+
+  for (int i = 0; i < simd_len; i += 32) {
+    __m256i acc[4];
+    for (int j = 0; j < 4; j++)
+      acc[j] = _mm256_setzero_si256();
+
+    for (int k = 0; k < taps; k += 2) {
+      __m256i wpair = _mm256_set1_epi32(
+          (int)((uint16_t)w[k] | ((uint32_t)(uint16_t)w[k + 1] << 16)));
+      for (int h = 0; h < 2; h++) {
+        __m256i a = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128((const __m128i *)(rows[k] + i + 16 * h)));
+        __m256i b = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128((const __m128i *)(rows[k + 1] + i + 16 * h)));
+        acc[2 * h] = _mm256_add_epi32(
+            acc[2 * h], _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), wpair));
+        acc[2 * h + 1] = _mm256_add_epi32(
+            acc[2 * h + 1],
+            _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), wpair));
+      }
+    }
+
+    for (int h = 0; h < 2; h++) {
+      __m256i packed = _mm256_packs_epi32(round_mid_avx2(acc[2 * h]),
+                                          round_mid_avx2(acc[2 * h + 1]));
+      _mm256_storeu_si256((__m256i *)(mid + i + 16 * h), packed);
+    }
+  }
+  vertical_scalar_span(rows, w, taps, mid, simd_len, len);
+}
+#endif
+
+bool downscale_kernel_supported(DownscaleKernel kernel) {
+  switch (kernel) {
+  case DOWNSCALE_KERNEL_SCALAR:
+    return true;
+#ifdef HAVE_X86_SIMD
+  case DOWNSCALE_KERNEL_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  case DOWNSCALE_KERNEL_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+DownscaleKernel downscale_best_kernel(void) {
+  static int best = -1;
+  if (best < 0) {
+    best = DOWNSCALE_KERNEL_SCALAR;
+    for (int k = DOWNSCALE_KERNEL_COUNT - 1; k > DOWNSCALE_KERNEL_SCALAR;
+         k--) {
+      if (downscale_kernel_supported(k)) {
+        best = k;
+        break;
+      }
+    }
+  }
+  return (DownscaleKernel)best;
+}
+
+const char *downscale_kernel_name(DownscaleKernel kernel) {
+  switch (kernel) {
+  case DOWNSCALE_KERNEL_SSE2:
+    return "sse2";
+  case DOWNSCALE_KERNEL_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+int downscale_argb32(DownscaleKernel kernel, const uint8_t *src, int src_w,
+                     int src_h, int src_stride, uint8_t *dst, int dst_w,
+                     int dst_h, int dst_stride) {
+  if (dst_w <= 0 || dst_h <= 0 || dst_w > src_w || dst_h > src_h)
+    return -1;
+  if (!downscale_kernel_supported(kernel))
+    kernel = DOWNSCALE_KERNEL_SCALAR;
+
+  VerticalFn vertical = vertical_scalar;
+  HorizontalFn horizontal = horizontal_scalar;
+#ifdef HAVE_X86_SIMD
+  if (kernel == DOWNSCALE_KERNEL_AVX2) {
+    vertical = vertical_avx2;
+    horizontal = horizontal_sse2;
+  } else if (kernel == DOWNSCALE_KERNEL_SSE2) {
+    vertical = vertical_sse2;
+    horizontal = horizontal_sse2;
+  }
+#endif
+
+  Filter fx = {0}, fy = {0};
+  /* One spare pixel: the SIMD horizontal pass reads taps in pairs */
+  int len = src_w * 4;
+  int16_t *mid = NULL;
+  const uint8_t **rows = NULL;
+  if (filter_build(&fx, src_w, dst_w) == 0 &&
+      filter_build(&fy, src_h, dst_h) == 0) {
+    mid = calloc((size_t)len + 4, sizeof(int16_t));
+    rows = malloc(fy.taps * sizeof(*rows));
+  }
+
+  int ret = -1;
+  if (mid && rows) {
+    for (int y = 0; y < dst_h; y++) {
+      const int16_t *w = fy.w + (size_t)y * fy.taps;
+      int first = fy.start[y];
+      int count = fy.count[y];
+
+      /* Padding taps point at a real row; their weight is 0 */
+      for (int k = 0; k < fy.taps; k++) {
+        int row = k < count ? first + k : first;
+        rows[k] = src + (size_t)row * src_stride;
+      }
+
+      vertical(rows, w, (count + 1) & ~1, mid, len);
+      horizontal(mid, &fx, dst + (size_t)y * dst_stride, dst_w);
+    }
+    ret = 0;
+  } else {
+    LOG("Out of memory scaling %dx%d to %dx%d", src_w, src_h, dst_w, dst_h);
+  }
+
+  free(mid);
+  free(rows);
+  filter_free(&fx);
+  filter_free(&fy);
+  return ret;
+}
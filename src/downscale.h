@@ -0,0 +1,30 @@
+/* src/downscale.h - Area-averaging Image Downscaler */
+#ifndef DOWNSCALE_H
+#define DOWNSCALE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Downscaler implementations, selected at runtime */
+typedef enum {
+  DOWNSCALE_KERNEL_SCALAR,
+  DOWNSCALE_KERNEL_SSE2,
+  DOWNSCALE_KERNEL_AVX2,
+  DOWNSCALE_KERNEL_COUNT
+} DownscaleKernel;
+
+/* Fastest kernel this CPU supports */
+DownscaleKernel downscale_best_kernel(void);
+bool downscale_kernel_supported(DownscaleKernel kernel);
+const char *downscale_kernel_name(DownscaleKernel kernel);
+
+/* Shrink a premultiplied ARGB32 image of src_w x src_h to dst_w x dst_h
+ * (no larger in either direction). Each output pixel is the average of
+ * the source area it covers, with partial pixels weighted by coverage.
+ * All kernels produce identical output. Returns 0, or -1 on bad sizes or
+ * when out of memory. */
+int downscale_argb32(DownscaleKernel kernel, const uint8_t *src, int src_w,
+                     int src_h, int src_stride, uint8_t *dst, int dst_w,
+                     int dst_h, int dst_stride);
+
+#endif /* DOWNSCALE_H */
@@ -0,0 +1,381 @@
+/* src/engine.c - Frame Compositing Engines
+ *
+ * Once chrome is in the sprite sheet and cards are in the card cache, a
+ * frame is mostly pixel-aligned copies and a few flat fills. Cairo still
+ * builds a path, a clip and a pattern for each of them. The pixman engine
+ * hands the same operations straight to pixman: sprite pieces and cards
+ * become composites of the cached pixels, rounded rectangles are solid
+ * rectangles plus corner masks computed once per radius. Coordinates are
+ * rounded to whole pixels, which is where every caller draws anyway.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "engine.h"
+#include <math.h>
+#include <pixman.h>
+#include <pthread.h>
+
+/* --- Cairo --- */
+
+static void cr_clear(cairo_t *cr) {
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_rgba(cr, 0, 0, 0, 0);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+}
+
+static void cr_image(cairo_t *cr, cairo_surface_t *image, double x, double y,
+                     double alpha) {
+  cairo_set_source_surface(cr, image, x, y);
+  if (alpha >= 1.0)
+    cairo_paint(cr);
+  else
+    cairo_paint_with_alpha(cr, alpha);
+}
+
+static void cr_rounded_rect(cairo_t *cr, double x, double y, double w,
+                            double h, double radius, uint32_t color,
+                            double alpha) {
+  double r, g, b;
+  color_to_rgb(color, &r, &g, &b);
+  cairo_set_source_rgba(cr, r, g, b, alpha);
+  draw_rounded_rect(cr, x, y, w, h, radius);
+  cairo_fill(cr);
+}
+
+const Engine engine_cairo = {
+    .name = "cairo",
+    .clear = cr_clear,
+    .sprite = sprites_draw,
+    .image = cr_image,
+    .rounded_rect = cr_rounded_rect,
+};
+
+/* --- Pixman --- */
+
+/* The pixels behind a cairo context, in its user space */
+typedef struct {
+  cairo_surface_t *surface;
+  pixman_image_t *image; /* Clipped to the context's clip */
+  int ox, oy;            /* User space origin in surface pixels */
+} Target;
+
+/* Wrap cr's target; false if it is not a plain ARGB32 image under a whole
+ * pixel translation, which only Cairo can draw to */
+static bool target_open(cairo_t *cr, Target *t) {
+  cairo_surface_t *surface = cairo_get_target(cr);
+  if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+      cairo_image_surface_get_format(surface) != CAIRO_FORMAT_ARGB32)
+    return false;
+
+  cairo_matrix_t m;
+  cairo_get_matrix(cr, &m);
+  if (m.xx != 1 || m.yy != 1 || m.xy != 0 || m.yx != 0 ||
+      m.x0 != floor(m.x0) || m.y0 != floor(m.y0))
+    return false;
+
+  cairo_surface_flush(surface);
+  int width = cairo_image_surface_get_width(surface);
+  int height = cairo_image_surface_get_height(surface);
+  t->image = pixman_image_create_bits(
+      PIXMAN_a8r8g8b8, width, height,
+      (uint32_t *)cairo_image_surface_get_data(surface),
+      cairo_image_surface_get_stride(surface));
+  if (!t->image)
+    return false;
+  t->surface = surface;
+  t->ox = (int)m.x0;
+  t->oy = (int)m.y0;
+
+  /* Clips in this renderer are rectangles, so the extents are exact */
+  double x1, y1, x2, y2;
+  cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+  int cx1 = (int)floor(x1) + t->ox, cy1 = (int)floor(y1) + t->oy;
+  int cx2 = (int)ceil(x2) + t->ox, cy2 = (int)ceil(y2) + t->oy;
+  cx1 = cx1 > 0 ? cx1 : 0;
+  cy1 = cy1 > 0 ? cy1 : 0;
+  cx2 = cx2 < width ? cx2 : width;
+  cy2 = cy2 < height ? cy2 : height;
+
+  pixman_region32_t clip;
+  pixman_region32_init_rect(&clip, cx1, cy1, cx2 > cx1 ? cx2 - cx1 : 0,
+                            cy2 > cy1 ? cy2 - cy1 : 0);
+  pixman_image_set_clip_region32(t->image, &clip);
+  pixman_region32_fini(&clip);
+  return true;
+}
+
+static void target_close(Target *t) {
+  pixman_image_unref(t->image);
+  cairo_surface_mark_dirty(t->surface);
+}
+
+/* Premultiplied 16-bit color, as pixman takes it */
+static pixman_color_t solid_color(uint32_t rgb, double alpha) {
+  double a = alpha * 257.0;
+  return (pixman_color_t){
+      .red = (uint16_t)lround(((rgb >> 16) & 0xff) * a),
+      .green = (uint16_t)lround(((rgb >> 8) & 0xff) * a),
+      .blue = (uint16_t)lround((rgb & 0xff) * a),
+      .alpha = (uint16_t)lround(0xff * a),
+  };
+}
+
+/* Mask scaling a composite by alpha, or NULL when opaque */
+static pixman_image_t *alpha_mask(double alpha) {
+  if (alpha >= 1.0)
+    return NULL;
+  pixman_color_t c = solid_color(0, alpha);
+  return pixman_image_create_solid_fill(&c);
+}
+
+static void pm_clear(cairo_t *cr) {
+  Target t;
+  if (!target_open(cr, &t)) {
+    cr_clear(cr);
+    return;
+  }
+  /* The clip region limits the fill to the clip */
+  pixman_color_t transparent = {0, 0, 0, 0};
+  pixman_rectangle16_t all = {0, 0, INT16_MAX, INT16_MAX};
+  pixman_image_fill_rectangles(PIXMAN_OP_SRC, t.image, &transparent, 1, &all);
+  target_close(&t);
+}
+
+/* Wrap an ARGB32 image surface for reading */
+static pixman_image_t *source_image(cairo_surface_t *surface) {
+  if (!surface || cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+      cairo_image_surface_get_format(surface) != CAIRO_FORMAT_ARGB32)
+    return NULL;
+  return pixman_image_create_bits(
+      PIXMAN_a8r8g8b8, cairo_image_surface_get_width(surface),
+      cairo_image_surface_get_height(surface),
+      (uint32_t *)cairo_image_surface_get_data(surface),
+      cairo_image_surface_get_stride(surface));
+}
+
+/* Stretch a piece of the sheet with nearest-neighbour sampling, like
+ * sprites_draw(). Only the piece is wrapped, so nothing outside it can be
+ * sampled. */
+static void stretch_piece(Target *t, cairo_surface_t *sheet,
+                          pixman_image_t *mask, int sx, int sy, int sw,
+                          int sh, int dx, int dy, int dw, int dh) {
+  unsigned char *data = cairo_image_surface_get_data(sheet);
+  int stride = cairo_image_surface_get_stride(sheet);
+  pixman_image_t *piece = pixman_image_create_bits(
+      PIXMAN_a8r8g8b8, sw, sh, (uint32_t *)(data + sy * stride + sx * 4),
+      stride);
+  if (!piece)
+    return;
+
+  struct pixman_transform scale;
+  pixman_transform_init_scale(&scale, pixman_double_to_fixed((double)sw / dw),
+                              pixman_double_to_fixed((double)sh / dh));
+  pixman_image_set_transform(piece, &scale);
+  pixman_image_set_filter(piece, PIXMAN_FILTER_NEAREST, NULL, 0);
+  pixman_image_set_repeat(piece, PIXMAN_REPEAT_PAD);
+  pixman_image_composite32(PIXMAN_OP_OVER, piece, mask, t->image, 0, 0, 0, 0,
+                           dx, dy, dw, dh);
+  pixman_image_unref(piece);
+}
+
+static void pm_sprite(cairo_t *cr, SpriteId id, double x, double y, double w,
+                      double h, double alpha) {
+  SpritePiece pieces[9];
+  int n = sprites_pieces(id, x, y, w, h, pieces);
+  cairo_surface_t *sheet = sprites_sheet();
+  if (n == 0 || !sheet)
+    return;
+
+  Target t;
+  pixman_image_t *src = source_image(sheet);
+  if (!src || !target_open(cr, &t)) {
+    if (src)
+      pixman_image_unref(src);
+    sprites_draw(cr, id, x, y, w, h, alpha);
+    return;
+  }
+
+  pixman_image_t *mask = alpha_mask(alpha);
+  for (int i = 0; i < n; i++) {
+    const SpritePiece *p = &pieces[i];
+    int sx = (int)lround(p->sx), sy = (int)lround(p->sy);
+    int sw = (int)lround(p->sw), sh = (int)lround(p->sh);
+    int dx = (int)lround(p->dx) + t.ox, dy = (int)lround(p->dy) + t.oy;
+    int dw = (int)lround(p->dw), dh = (int)lround(p->dh);
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
+      continue;
+
+    if (sw == dw && sh == dh)
+      pixman_image_composite32(PIXMAN_OP_OVER, src, mask, t.image, sx, sy, 0,
+                               0, dx, dy, dw, dh);
+    else
+      stretch_piece(&t, sheet, mask, sx, sy, sw, sh, dx, dy, dw, dh);
+  }
+
+  if (mask)
+    pixman_image_unref(mask);
+  pixman_image_unref(src);
+  target_close(&t);
+}
+
+static void pm_image(cairo_t *cr, cairo_surface_t *image, double x, double y,
+                     double alpha) {
+  Target t;
+  pixman_image_t *src = source_image(image);
+  if (!src || !target_open(cr, &t)) {
+    if (src)
+      pixman_image_unref(src);
+    cr_image(cr, image, x, y, alpha);
+    return;
+  }
+
+  pixman_image_t *mask = alpha_mask(alpha);
+  pixman_image_composite32(PIXMAN_OP_OVER, src, mask, t.image, 0, 0, 0, 0,
+                           (int)lround(x) + t.ox, (int)lround(y) + t.oy,
+                           cairo_image_surface_get_width(image),
+                           cairo_image_surface_get_height(image));
+  if (mask)
+    pixman_image_unref(mask);
+  pixman_image_unref(src);
+  target_close(&t);
+}
+
+/* Antialiased discs by radius, shared by all threads: each fills a
+ * 2r x 2r A8 image, and its quarters are the corners of a rounded
+ * rectangle. Replaced round-robin; users hold a reference. */
+#define CORNER_MASKS 8
+#define CORNER_SAMPLES 4 /* Per axis and pixel */
+
+static struct {
+  int radius;
+  pixman_image_t *mask;
+} corners[CORNER_MASKS];
+static int next_corner = 0;
+static pthread_mutex_t corner_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pixman_image_t *create_disc(int r) {
+  int size = 2 * r;
+  pixman_image_t *mask =
+      pixman_image_create_bits(PIXMAN_a8, size, size, NULL, 0);
+  if (!mask)
+    return NULL;
+
+  uint8_t *data = (uint8_t *)pixman_image_get_data(mask);
+  int stride = pixman_image_get_stride(mask);
+  const int n = CORNER_SAMPLES;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int inside = 0;
+      for (int j = 0; j < n; j++) {
+        double dy = y + (j + 0.5) / n - r;
+        for (int i = 0; i < n; i++) {
+          double dx = x + (i + 0.5) / n - r;
+          if (dx * dx + dy * dy <= (double)r * r)
+            inside++;
+        }
+      }
+      data[y * stride + x] = (uint8_t)((inside * 255 + n * n / 2) / (n * n));
+    }
+  }
+  return mask;
+}
+
+/* Disc of radius r (new reference), or NULL if out of memory */
+static pixman_image_t *get_disc(int r) {
+  pthread_mutex_lock(&corner_lock);
+  pixman_image_t *mask = NULL;
+  for (int i = 0; i < CORNER_MASKS && !mask; i++) {
+    if (corners[i].mask && corners[i].radius == r)
+      mask = corners[i].mask;
+  }
+  if (!mask) {
+    mask = create_disc(r);
+    if (mask) {
+      if (corners[next_corner].mask)
+        pixman_image_unref(corners[next_corner].mask);
+      corners[next_corner].radius = r;
+      corners[next_corner].mask = mask;
+      next_corner = (next_corner + 1) % CORNER_MASKS;
+    }
+  }
+  if (mask)
+    pixman_image_ref(mask);
+  pthread_mutex_unlock(&corner_lock);
+  return mask;
+}
+
+static void pm_rounded_rect(cairo_t *cr, double x, double y, double w,
+                            double h, double radius, uint32_t color,
+                            double alpha) {
+  int x1 = (int)lround(x), y1 = (int)lround(y);
+  int x2 = (int)lround(x + w), y2 = (int)lround(y + h);
+  if (x2 <= x1 || y2 <= y1)
+    return;
+
+  int r = (int)lround(radius);
+  if (r > (x2 - x1) / 2)
+    r = (x2 - x1) / 2;
+  if (r > (y2 - y1) / 2)
+    r = (y2 - y1) / 2;
+
+  Target t;
+  pixman_image_t *disc = r > 0 ? get_disc(r) : NULL;
+  if ((r > 0 && !disc) || !target_open(cr, &t)) {
+    if (disc)
+      pixman_image_unref(disc);
+    cr_rounded_rect(cr, x, y, w, h, radius, color, alpha);
+    return;
+  }
+  x1 += t.ox;
+  x2 += t.ox;
+  y1 += t.oy;
+  y2 += t.oy;
+
+  pixman_color_t c = solid_color(color, alpha);
+  if (disc) {
+    pixman_image_t *src = pixman_image_create_solid_fill(&c);
+    pixman_image_composite32(PIXMAN_OP_OVER, src, disc, t.image, 0, 0, 0, 0,
+                             x1, y1, r, r);
+    pixman_image_composite32(PIXMAN_OP_OVER, src, disc, t.image, 0, 0, r, 0,
+                             x2 - r, y1, r, r);
+    pixman_image_composite32(PIXMAN_OP_OVER, src, disc, t.image, 0, 0, 0, r,
+                             x1, y2 - r, r, r);
+    pixman_image_composite32(PIXMAN_OP_OVER, src, disc, t.image, 0, 0, r, r,
+                             x2 - r, y2 - r, r, r);
+    pixman_image_unref(src);
+    pixman_image_unref(disc);
+  }
+
+  /* Everything between the corners is solid */
+  pixman_rectangle16_t cross[3] = {
+      {x1 + r, y1, x2 - x1 - 2 * r, r},
+      {x1, y1 + r, x2 - x1, y2 - y1 - 2 * r},
+      {x1 + r, y2 - r, x2 - x1 - 2 * r, r},
+  };
+  pixman_image_fill_rectangles(PIXMAN_OP_OVER, t.image, &c, 3, cross);
+  target_close(&t);
+}
+
+const Engine engine_pixman = {
+    .name = "pixman",
+    .clear = pm_clear,
+    .sprite = pm_sprite,
+    .image = pm_image,
+    .rounded_rect = pm_rounded_rect,
+};
+
+const Engine *engine_get(RenderEngine type) {
+  return type == RENDER_ENGINE_PIXMAN ? &engine_pixman : &engine_cairo;
+}
+
+void engine_cleanup(void) {
+  pthread_mutex_lock(&corner_lock);
+  for (int i = 0; i < CORNER_MASKS; i++) {
+    if (corners[i].mask)
+      pixman_image_unref(corners[i].mask);
+    corners[i].mask = NULL;
+  }
+  next_corner = 0;
+  pthread_mutex_unlock(&corner_lock);
+}
@@ -0,0 +1,44 @@
+/* src/engine.h - Frame Compositing Engines */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "config.h"
+#include "sprites.h"
+#include <cairo/cairo.h>
+#include <stdint.h>
+
+/* Assembling a frame from pre-rasterized pieces: chrome sprites, cached
+ * cards and flat shapes. Text, icons and the cards themselves are always
+ * drawn with Cairo and Pango. Operations honour cr's clip and translation,
+ * so engines can be mixed within a frame; cr must target an ARGB32 image
+ * surface (others fall back to Cairo). Safe to call from tile workers,
+ * each with its own cr. */
+typedef struct {
+  const char *name;
+
+  /* Make everything inside the clip transparent */
+  void (*clear)(cairo_t *cr);
+
+  /* Draw a sprite, as sprites_draw() */
+  void (*sprite)(cairo_t *cr, SpriteId id, double x, double y, double w,
+                 double h, double alpha);
+
+  /* Composite an ARGB32 image with its top-left corner at x, y */
+  void (*image)(cairo_t *cr, cairo_surface_t *image, double x, double y,
+                double alpha);
+
+  /* Fill a rounded rectangle with a color (0xRRGGBB) */
+  void (*rounded_rect)(cairo_t *cr, double x, double y, double w, double h,
+                       double radius, uint32_t color, double alpha);
+} Engine;
+
+extern const Engine engine_cairo;
+extern const Engine engine_pixman;
+
+/* Engine selected by the config */
+const Engine *engine_get(RenderEngine type);
+
+/* Free cached corner masks (no engine call may be running) */
+void engine_cleanup(void);
+
+#endif /* ENGINE_H */
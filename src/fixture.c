@@ -0,0 +1,107 @@
+/* src/fixture.c - Window List Fixtures for Offscreen Rendering */
+#define _POSIX_C_SOURCE 200809L
+
+#include "fixture.h"
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Fixture] " fmt "\n", ##__VA_ARGS__)
+
+/* Copy of a string member, or of fallback when it is missing */
+static char *get_string(json_object *obj, const char *key,
+                        const char *fallback) {
+  json_object *val;
+  if (json_object_object_get_ex(obj, key, &val) &&
+      json_object_is_type(val, json_type_string))
+    return strdup(json_object_get_string(val));
+  return fallback ? strdup(fallback) : NULL;
+}
+
+static int get_int(json_object *obj, const char *key, int fallback) {
+  json_object *val;
+  if (json_object_object_get_ex(obj, key, &val))
+    return json_object_get_int(val);
+  return fallback;
+}
+
+static bool get_bool(json_object *obj, const char *key) {
+  json_object *val;
+  return json_object_object_get_ex(obj, key, &val) &&
+         json_object_get_boolean(val);
+}
+
+static int add_window(AppState *state, json_object *obj, int index) {
+  char address[32];
+  snprintf(address, sizeof(address), "fixture-%d", index);
+
+  WindowInfo win;
+  memset(&win, 0, sizeof(win));
+  win.address = get_string(obj, "address", address);
+  win.title = get_string(obj, "title", "Untitled");
+  win.class_name = get_string(obj, "class", NULL);
+  if (!win.class_name)
+    win.class_name = get_string(obj, "app_id", "unknown");
+  win.workspace_id = get_int(obj, "workspace", 0);
+  win.focus_history_id = index;
+  win.is_active = get_bool(obj, "active");
+  win.is_floating = get_bool(obj, "floating");
+  win.group_count = get_int(obj, "group_count", 1);
+  if (win.group_count < 1)
+    win.group_count = 1;
+
+  if (!win.address || !win.title || !win.class_name ||
+      app_state_add(state, &win) < 0) {
+    window_info_free(&win);
+    return -1;
+  }
+  return 0;
+}
+
+int fixture_load(const char *path, AppState *state) {
+  json_object *root = json_object_from_file(path);
+  if (!root) {
+    LOG("Cannot read or parse %s", path);
+    return -1;
+  }
+
+  json_object *windows = root;
+  int selected = -1;
+  if (json_object_is_type(root, json_type_object)) {
+    if (!json_object_object_get_ex(root, "windows", &windows))
+      windows = NULL;
+    selected = get_int(root, "selected", -1);
+  }
+
+  if (!windows || !json_object_is_type(windows, json_type_array)) {
+    LOG("%s: expected an array of windows", path);
+    json_object_put(root);
+    return -1;
+  }
+
+  size_t n = json_object_array_length(windows);
+  for (size_t i = 0; i < n; i++) {
+    json_object *obj = json_object_array_get_idx(windows, i);
+    if (!json_object_is_type(obj, json_type_object)) {
+      LOG("%s: window %zu is not an object", path, i);
+      continue;
+    }
+    if (add_window(state, obj, (int)i) < 0) {
+      LOG("Out of memory loading %s", path);
+      json_object_put(root);
+      return -1;
+    }
+  }
+  json_object_put(root);
+
+  /* Like a show: the previously focused window, unless the fixture says */
+  if (selected < 0)
+    selected = state->count > 1 ? 1 : 0;
+  if (selected >= state->count)
+    selected = state->count > 0 ? state->count - 1 : 0;
+  state->selected_index = selected;
+
+  LOG("Loaded %d windows from %s", state->count, path);
+  return 0;
+}
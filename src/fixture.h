@@ -0,0 +1,14 @@
+/* src/fixture.h - Window List Fixtures for Offscreen Rendering */
+#ifndef FIXTURE_H
+#define FIXTURE_H
+
+#include "data.h"
+
+/* Load a JSON window list into an initialized state. The file holds
+ * either an array of windows or an object with "windows" and an optional
+ * "selected" index. Each window may set "title", "class", "address",
+ * "workspace", "group_count", "active" and "floating".
+ * Returns 0 on success, -1 on a read or syntax error (logged). */
+int fixture_load(const char *path, AppState *state);
+
+#endif /* FIXTURE_H */
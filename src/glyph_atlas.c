@@ -0,0 +1,457 @@
+/* src/glyph_atlas.c - Glyph Atlas Title Renderer
+ *
+ * A first show of a large panel shapes every title with Pango, which
+ * costs far more than drawing it. Titles in simple scripts (Latin, Greek,
+ * Cyrillic and common punctuation: one glyph per character, left to
+ * right, no combining marks) do not need shaping. Each character's
+ * advance and pair kerning are measured with Pango once, its coverage is
+ * rasterized once per quarter-pixel phase into an A8 atlas, and a title
+ * is then laid out with table lookups and blended straight into the card.
+ *
+ * Atlases are per (font, size in Pango units), and the size already
+ * includes the output scale. Like text.c, all state is per thread.
+ * Anything else is left to Pango by returning false before drawing.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "glyph_atlas.h"
+#include "text.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Atlas] " fmt "\n", ##__VA_ARGS__)
+
+#define MAX_ATLASES 4
+#define MAX_GLYPHS 1024      /* Hash slots per atlas, a power of two */
+#define MAX_KERNS 4096       /* Hash slots per atlas, a power of two */
+#define MAX_TITLE_CHARS 256  /* Longer titles go to Pango */
+#define SUBPIXEL_STEPS 4     /* Horizontal glyph phases, as Cairo uses */
+#define ATLAS_WIDTH 512
+#define ATLAS_MAX_HEIGHT 2048
+
+#define ELLIPSIS 0x2026
+
+/* Coverage of a glyph at one subpixel phase */
+typedef struct {
+  bool ready;
+  uint16_t x, y; /* In the atlas */
+  uint16_t width, height;
+  int16_t left, top; /* Relative to the pen on the baseline */
+} GlyphImage;
+
+typedef struct {
+  uint32_t codepoint; /* 0 = empty slot */
+  int advance;        /* Pango units */
+  int baseline;       /* Of the glyph's own layout, Pango units */
+  PangoRectangle ink; /* Relative to the layout's top left */
+  GlyphImage image[SUBPIXEL_STEPS];
+} Glyph;
+
+typedef struct {
+  uint64_t pair; /* First << 32 | second, 0 = empty slot */
+  int kern;      /* Pango units */
+} Kern;
+
+typedef struct {
+  PangoFontDescription *font; /* NULL = unused */
+  int baseline;               /* Line baseline below its top, Pango units */
+  Glyph *glyphs;
+  int glyph_count;
+  Kern *kerns;
+  int kern_count;
+  uint8_t *pixels; /* ATLAS_WIDTH x height coverage */
+  int height;
+  int shelf_x, shelf_y, shelf_h;
+  bool full; /* Reset before the next title */
+  unsigned long access_time;
+} Atlas;
+
+static _Thread_local Atlas atlases[MAX_ATLASES];
+static _Thread_local unsigned long lru_counter = 0;
+
+/* Scripts that are one glyph per character, left to right, with no marks
+ * to position. Controls, bidi and zero-width characters are excluded. */
+static bool is_simple(uint32_t c) {
+  if (c < 0x20 || (c >= 0x7f && c < 0xa0) || c == 0xad)
+    return false;
+  if (c < 0x0300)
+    return true; /* Latin, IPA, spacing modifiers */
+  if (c >= 0x0483 && c < 0x048a)
+    return false; /* Cyrillic combining marks */
+  if (c >= 0x0370 && c < 0x0530)
+    return true; /* Greek, Cyrillic */
+  if (c >= 0x1e00 && c < 0x2000)
+    return true; /* Latin Extended Additional, Greek Extended */
+  if (c >= 0x2010 && c < 0x2028)
+    return true; /* Dashes, quotes, bullets, ellipsis */
+  if (c >= 0x2030 && c < 0x205f)
+    return true;
+  if (c >= 0x20a0 && c < 0x20c1)
+    return true; /* Currency */
+  return c >= 0x2100 && c < 0x2200; /* Letterlike, arrows, number forms */
+}
+
+static void atlas_reset(Atlas *a) {
+  memset(a->glyphs, 0, MAX_GLYPHS * sizeof(Glyph));
+  memset(a->kerns, 0, MAX_KERNS * sizeof(Kern));
+  a->glyph_count = 0;
+  a->kern_count = 0;
+  a->shelf_x = a->shelf_y = a->shelf_h = 0;
+  a->full = false;
+}
+
+static void atlas_free(Atlas *a) {
+  if (a->font)
+    pango_font_description_free(a->font);
+  free(a->glyphs);
+  free(a->kerns);
+  free(a->pixels);
+  memset(a, 0, sizeof(Atlas));
+}
+
+static PangoLayout *new_layout(const PangoFontDescription *font,
+                               const char *text) {
+  PangoLayout *layout = pango_layout_new(text_context());
+  pango_layout_set_font_description(layout, font);
+  pango_layout_set_text(layout, text, -1);
+  return layout;
+}
+
+/* Atlas for a size, least recently used one recycled on a miss */
+static Atlas *atlas_for_size(int size) {
+  const PangoFontDescription *font = text_font(size);
+  Atlas *lru = &atlases[0];
+  for (int i = 0; i < MAX_ATLASES; i++) {
+    Atlas *a = &atlases[i];
+    if (a->font && pango_font_description_equal(a->font, font)) {
+      a->access_time = ++lru_counter;
+      if (a->full) {
+        LOG("Atlas for size %d is full, starting over", size);
+        atlas_reset(a);
+      }
+      return a;
+    }
+    if (!a->font || (lru->font && a->access_time < lru->access_time))
+      lru = a;
+  }
+
+  atlas_free(lru);
+  lru->glyphs = calloc(MAX_GLYPHS, sizeof(Glyph));
+  lru->kerns = calloc(MAX_KERNS, sizeof(Kern));
+  lru->font = pango_font_description_copy(font);
+  if (!lru->glyphs || !lru->kerns || !lru->font) {
+    atlas_free(lru);
+    return NULL;
+  }
+
+  PangoLayout *layout = new_layout(font, "x");
+  lru->baseline = pango_layout_get_baseline(layout);
+  g_object_unref(layout);
+  lru->access_time = ++lru_counter;
+  return lru;
+}
+
+static unsigned int hash_u32(uint32_t v) { return v * 2654435761u; }
+
+/* Advance and extents of a character, measured on first use */
+static Glyph *glyph_lookup(Atlas *a, uint32_t codepoint) {
+  unsigned int slot = hash_u32(codepoint) & (MAX_GLYPHS - 1);
+  while (a->glyphs[slot].codepoint) {
+    if (a->glyphs[slot].codepoint == codepoint)
+      return &a->glyphs[slot];
+    slot = (slot + 1) & (MAX_GLYPHS - 1);
+  }
+
+  /* Keep probes short; a full table is rebuilt for the next title */
+  if (a->glyph_count >= MAX_GLYPHS * 3 / 4) {
+    a->full = true;
+    return NULL;
+  }
+
+  char utf8[8];
+  utf8[g_unichar_to_utf8(codepoint, utf8)] = '\0';
+  PangoLayout *layout = new_layout(a->font, utf8);
+  PangoRectangle logical;
+
+  Glyph *g = &a->glyphs[slot];
+  pango_layout_get_extents(layout, &g->ink, &logical);
+  g->baseline = pango_layout_get_baseline(layout);
+  g->advance = logical.width;
+  g->codepoint = codepoint;
+  a->glyph_count++;
+  g_object_unref(layout);
+  return g;
+}
+
+/* Kerning between two characters: the pair's advance minus the parts */
+static int kern_lookup(Atlas *a, const Glyph *first, const Glyph *second) {
+  uint64_t pair = (uint64_t)first->codepoint << 32 | second->codepoint;
+  unsigned int slot =
+      hash_u32(first->codepoint * 31 + second->codepoint) & (MAX_KERNS - 1);
+  while (a->kerns[slot].pair) {
+    if (a->kerns[slot].pair == pair)
+      return a->kerns[slot].kern;
+    slot = (slot + 1) & (MAX_KERNS - 1);
+  }
+
+  char utf8[16];
+  int len = g_unichar_to_utf8(first->codepoint, utf8);
+  utf8[len + g_unichar_to_utf8(second->codepoint, utf8 + len)] = '\0';
+  PangoLayout *layout = new_layout(a->font, utf8);
+  int width;
+  pango_layout_get_size(layout, &width, NULL);
+  g_object_unref(layout);
+
+  int kern = width - first->advance - second->advance;
+  if (a->kern_count < MAX_KERNS * 3 / 4) {
+    a->kerns[slot].pair = pair;
+    a->kerns[slot].kern = kern;
+    a->kern_count++;
+  }
+  return kern;
+}
+
+/* Room for a w x h image on the current shelf, or a new one */
+static bool atlas_alloc(Atlas *a, int w, int h, int *x, int *y) {
+  if (w > ATLAS_WIDTH)
+    return false;
+  if (a->shelf_x + w > ATLAS_WIDTH) {
+    a->shelf_y += a->shelf_h;
+    a->shelf_x = 0;
+    a->shelf_h = 0;
+  }
+  if (a->shelf_y + h > a->height) {
+    int height = a->height ? a->height : 64;
+    while (height < a->shelf_y + h)
+      height *= 2;
+    if (height > ATLAS_MAX_HEIGHT)
+      return false;
+    uint8_t *pixels = realloc(a->pixels, (size_t)ATLAS_WIDTH * height);
+    if (!pixels)
+      return false;
+    a->pixels = pixels;
+    a->height = height;
+  }
+
+  *x = a->shelf_x;
+  *y = a->shelf_y;
+  a->shelf_x += w;
+  if (h > a->shelf_h)
+    a->shelf_h = h;
+  return true;
+}
+
+/* Coverage of a glyph at a phase, rasterized with Pango on first use */
+static const GlyphImage *glyph_image(Atlas *a, Glyph *g, int phase) {
+  GlyphImage *img = &g->image[phase];
+  if (img->ready)
+    return img;
+
+  /* Whole pixels around the ink, one spare on each side for antialiasing
+   * and one more on the right for the phase shift */
+  int left = (int)floor(g->ink.x / (double)PANGO_SCALE) - 1;
+  int right =
+      (int)ceil((g->ink.x + g->ink.width) / (double)PANGO_SCALE) + 2;
+  int top = (int)floor((g->ink.y - g->baseline) / (double)PANGO_SCALE) - 1;
+  int bottom = (int)ceil((g->ink.y + g->ink.height - g->baseline) /
+                         (double)PANGO_SCALE) +
+               1;
+
+  img->left = (int16_t)left;
+  img->top = (int16_t)top;
+  if (g->ink.width <= 0 || g->ink.height <= 0) {
+    img->width = img->height = 0; /* Blank, such as a space */
+    img->ready = true;
+    return img;
+  }
+
+  int w = right - left;
+  int h = bottom - top;
+  int ax, ay;
+  if (!atlas_alloc(a, w, h, &ax, &ay)) {
+    a->full = true;
+    return NULL;
+  }
+
+  cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_A8, w, h);
+  cairo_t *cr = cairo_create(surface);
+  char utf8[8];
+  utf8[g_unichar_to_utf8(g->codepoint, utf8)] = '\0';
+  PangoLayout *layout = new_layout(a->font, utf8);
+  cairo_move_to(cr, -left + phase / (double)SUBPIXEL_STEPS,
+                -top - g->baseline / (double)PANGO_SCALE);
+  pango_cairo_show_layout(cr, layout);
+  g_object_unref(layout);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+
+  const uint8_t *src = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  for (int row = 0; row < h; row++)
+    memcpy(a->pixels + (size_t)(ay + row) * ATLAS_WIDTH + ax,
+           src + (size_t)row * stride, w);
+  cairo_surface_destroy(surface);
+
+  img->x = (uint16_t)ax;
+  img->y = (uint16_t)ay;
+  img->width = (uint16_t)w;
+  img->height = (uint16_t)h;
+  img->ready = true;
+  return img;
+}
+
+/* a * b / 255, rounded as pixman does */
+static inline uint32_t mul_un8(uint32_t a, uint32_t b) {
+  uint32_t t = a * b + 0x80;
+  return ((t >> 8) + t) >> 8;
+}
+
+/* Composite a solid color OVER dst through the glyph's coverage */
+static void blit_glyph(const Atlas *a, const GlyphImage *img, uint8_t *data,
+                       int stride, int x0, int y0, int x1, int y1, int x,
+                       int y, uint32_t color) {
+  int gx0 = x > x0 ? x : x0;
+  int gy0 = y > y0 ? y : y0;
+  int gx1 = x + img->width < x1 ? x + img->width : x1;
+  int gy1 = y + img->height < y1 ? y + img->height : y1;
+  uint32_t r = (color >> 16) & 0xff;
+  uint32_t g = (color >> 8) & 0xff;
+  uint32_t b = color & 0xff;
+
+  for (int py = gy0; py < gy1; py++) {
+    const uint8_t *cov =
+        a->pixels + (size_t)(img->y + py - y) * ATLAS_WIDTH + img->x;
+    uint32_t *row = (uint32_t *)(data + (size_t)py * stride);
+    for (int px = gx0; px < gx1; px++) {
+      uint32_t c = cov[px - x];
+      if (c == 0)
+        continue;
+      if (c == 255) {
+        row[px] = 0xff000000u | color;
+        continue;
+      }
+      uint32_t d = row[px];
+      uint32_t inv = 255 - c;
+      row[px] = (c + mul_un8(d >> 24, inv)) << 24 |
+                (mul_un8(r, c) + mul_un8((d >> 16) & 0xff, inv)) << 16 |
+                (mul_un8(g, c) + mul_un8((d >> 8) & 0xff, inv)) << 8 |
+                (mul_un8(b, c) + mul_un8(d & 0xff, inv));
+    }
+  }
+}
+
+bool glyph_atlas_draw_title(cairo_t *cr, const char *title, double x,
+                            double y, int width, int size, uint32_t color) {
+  cairo_surface_t *target = cairo_get_target(cr);
+  if (cairo_surface_get_type(target) != CAIRO_SURFACE_TYPE_IMAGE ||
+      cairo_image_surface_get_format(target) != CAIRO_FORMAT_ARGB32)
+    return false;
+  cairo_matrix_t m;
+  cairo_get_matrix(cr, &m);
+  if (m.xx != 1.0 || m.yy != 1.0 || m.xy != 0.0 || m.yx != 0.0)
+    return false;
+  cairo_user_to_device(cr, &x, &y);
+  if (x < 0 || y < 0)
+    return false;
+
+  uint32_t chars[MAX_TITLE_CHARS];
+  int n = 0;
+  for (const char *p = title ? title : ""; *p; p = g_utf8_next_char(p)) {
+    uint32_t c = g_utf8_get_char_validated(p, -1);
+    if (n == MAX_TITLE_CHARS || c >= 0x110000 || !is_simple(c))
+      return false;
+    chars[n++] = c;
+  }
+
+  Atlas *a = atlas_for_size(size);
+  if (!a)
+    return false;
+
+  /* Lay out in Pango units: pen[i] is where character i starts */
+  Glyph *glyphs[MAX_TITLE_CHARS];
+  int pen[MAX_TITLE_CHARS + 1];
+  pen[0] = 0;
+  for (int i = 0; i < n; i++) {
+    glyphs[i] = glyph_lookup(a, chars[i]);
+    if (!glyphs[i])
+      return false;
+  }
+  for (int i = 0; i < n; i++) {
+    pen[i + 1] = pen[i] + glyphs[i]->advance;
+    if (i + 1 < n)
+      pen[i + 1] += kern_lookup(a, glyphs[i], glyphs[i + 1]);
+  }
+
+  /* Ellipsize at the end like PANGO_ELLIPSIZE_END: drop characters until
+   * what is left plus an ellipsis fits */
+  int limit = width * PANGO_SCALE;
+  int count = n;
+  int line = n ? pen[n - 1] + glyphs[n - 1]->advance : 0;
+  Glyph *dots = NULL;
+  if (line > limit) {
+    dots = glyph_lookup(a, ELLIPSIS);
+    if (!dots)
+      return false;
+    while (count > 0 &&
+           pen[count - 1] + glyphs[count - 1]->advance + dots->advance > limit)
+      count--;
+    int end = count ? pen[count - 1] + glyphs[count - 1]->advance : 0;
+    pen[count] = end;
+    glyphs[count] = dots;
+    count++;
+    line = end + dots->advance;
+  }
+
+  /* Resolve every image first: a miss that cannot be stored must fall
+   * back to Pango before anything is drawn */
+  int origin = (int)lround(x * PANGO_SCALE) + (limit - line) / 2;
+  int baseline = (int)lround(y + a->baseline / (double)PANGO_SCALE);
+  const GlyphImage *images[MAX_TITLE_CHARS];
+  int pos[MAX_TITLE_CHARS];
+  for (int i = 0; i < count; i++) {
+    /* Quarter pixels, rounded to the nearest */
+    int quarters = (origin + pen[i] + PANGO_SCALE / 8) /
+                   (PANGO_SCALE / SUBPIXEL_STEPS);
+    if (quarters < 0)
+      return false;
+    images[i] = glyph_image(a, glyphs[i], quarters % SUBPIXEL_STEPS);
+    if (!images[i])
+      return false;
+    pos[i] = quarters / SUBPIXEL_STEPS;
+  }
+
+  /* The caller's clip is honoured by its extents only */
+  double cx0, cy0, cx1, cy1;
+  cairo_clip_extents(cr, &cx0, &cy0, &cx1, &cy1);
+  cairo_user_to_device(cr, &cx0, &cy0);
+  cairo_user_to_device(cr, &cx1, &cy1);
+  int x0 = cx0 > 0 ? (int)ceil(cx0) : 0;
+  int y0 = cy0 > 0 ? (int)ceil(cy0) : 0;
+  int x1 = cairo_image_surface_get_width(target);
+  int y1 = cairo_image_surface_get_height(target);
+  if (cx1 < x1)
+    x1 = (int)floor(cx1);
+  if (cy1 < y1)
+    y1 = (int)floor(cy1);
+
+  cairo_surface_flush(target);
+  uint8_t *data = cairo_image_surface_get_data(target);
+  int stride = cairo_image_surface_get_stride(target);
+  for (int i = 0; i < count; i++) {
+    if (images[i]->width)
+      blit_glyph(a, images[i], data, stride, x0, y0, x1, y1,
+                 pos[i] + images[i]->left, baseline + images[i]->top,
+                 color & 0xffffff);
+  }
+  if (x1 > x0 && y1 > y0)
+    cairo_surface_mark_dirty_rectangle(target, x0, y0, x1 - x0, y1 - y0);
+  return true;
+}
+
+void glyph_atlas_cleanup(void) {
+  for (int i = 0; i < MAX_ATLASES; i++)
+    atlas_free(&atlases[i]);
+  lru_counter = 0;
+}
@@ -0,0 +1,22 @@
+/* src/glyph_atlas.h - Glyph Atlas Title Renderer */
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <cairo/cairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Like text.h, everything here works on the calling thread's own atlases */
+
+/* Draw a title as text_title_layout() would lay it out at (x, y):
+ * ellipsized at width pixels and centered, size in Pango units, color as
+ * 0xRRGGBB. Only handles simple scripts drawn straight into an ARGB32
+ * image without scaling. Returns false, having drawn nothing, when the
+ * title needs Pango instead. */
+bool glyph_atlas_draw_title(cairo_t *cr, const char *title, double x,
+                            double y, int width, int size, uint32_t color);
+
+/* Free the calling thread's atlases */
+void glyph_atlas_cleanup(void);
+
+#endif /* GLYPH_ATLAS_H */
@@ -0,0 +1,66 @@
+/* src/governor.c - Render Quality Governor
+ *
+ * Full repaints are timed against the configured budget. One over it
+ * drops a tier for the next frame; a run of repaints well inside it
+ * climbs one back. A tier change empties the card cache, so the repaint
+ * after it pays for rasterizing every card again, and that is what gets
+ * measured: requiring a run of fast frames before climbing keeps that
+ * cost from bouncing the governor between two tiers.
+ */
+#include "governor.h"
+#include <stdio.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Governor] " fmt "\n", ##__VA_ARGS__)
+
+/* Repaints under this share of the budget have headroom... */
+#define HEADROOM 0.5
+/* ...and this many of them in a row step a tier up */
+#define HEADROOM_FRAMES 8
+
+static const char *const tier_names[QUALITY_COUNT] = {
+    "best", "good", "fast", "no-letters", "no-stack",
+};
+
+/* Render thread */
+static QualityTier tier = QUALITY_BEST;
+static int calm_frames = 0;
+
+QualityTier governor_tier(void) { return tier; }
+
+bool governor_update(double budget_ms, double render_ms) {
+  QualityTier old = tier;
+
+  if (budget_ms <= 0) {
+    tier = QUALITY_BEST;
+    calm_frames = 0;
+  } else if (render_ms > budget_ms) {
+    calm_frames = 0;
+    if (tier < QUALITY_COUNT - 1)
+      tier++;
+  } else if (render_ms < budget_ms * HEADROOM) {
+    if (tier > QUALITY_BEST && ++calm_frames >= HEADROOM_FRAMES) {
+      tier--;
+      calm_frames = 0;
+    }
+  } else {
+    calm_frames = 0;
+  }
+
+  if (tier == old)
+    return false;
+  LOG("%.2f ms against a %.1f ms budget, drawing at %s", render_ms,
+      budget_ms, tier_names[tier]);
+  return true;
+}
+
+const char *governor_tier_name(QualityTier tier) {
+  return tier >= 0 && tier < QUALITY_COUNT ? tier_names[tier] : "?";
+}
+
+cairo_antialias_t governor_antialias(QualityTier tier) {
+  if (tier == QUALITY_BEST)
+    return CAIRO_ANTIALIAS_BEST;
+  if (tier == QUALITY_GOOD)
+    return CAIRO_ANTIALIAS_GOOD;
+  return CAIRO_ANTIALIAS_FAST;
+}
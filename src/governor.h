@@ -0,0 +1,33 @@
+/* src/governor.h - Render Quality Governor */
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <cairo/cairo.h>
+#include <stdbool.h>
+
+/* What a frame is drawn with, from best to cheapest. Each tier keeps the
+ * savings of the ones above it. */
+typedef enum {
+  QUALITY_BEST,       /* Antialias BEST */
+  QUALITY_GOOD,       /* Antialias GOOD */
+  QUALITY_FAST,       /* Antialias FAST */
+  QUALITY_NO_LETTERS, /* No letter tiles for windows without an icon */
+  QUALITY_NO_STACK,   /* No stacked layers behind grouped cards */
+  QUALITY_COUNT
+} QualityTier;
+
+/* Tier for the next frame (render thread) */
+QualityTier governor_tier(void);
+
+/* Feed the time a full repaint took against budget_ms (<= 0 turns the
+ * governor off and goes back to QUALITY_BEST). Returns true if the tier
+ * for the next frame changed. */
+bool governor_update(double budget_ms, double render_ms);
+
+/* Short name for logs and the overlay, e.g. "good" */
+const char *governor_tier_name(QualityTier tier);
+
+/* Antialiasing a tier draws with */
+cairo_antialias_t governor_antialias(QualityTier tier);
+
+#endif /* GOVERNOR_H */
@@ -0,0 +1,205 @@
+/* src/headless.c - Offscreen Rendering Without a Compositor
+ *
+ * Renders a window list from a JSON fixture into memory with the same code
+ * the daemon uses, so rendering can be profiled and themes compared on
+ * machines without Wayland (CI, build boxes).
+ *
+ *   wswitch --render-png out.png --windows fixture.json --theme nord.ini
+ *           [--scale 1.5] [--repeat N] [--cold]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "headless.h"
+#include "config.h"
+#include "data.h"
+#include "fixture.h"
+#include "icons.h"
+#include "render.h"
+#include <cairo/cairo.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Headless] " fmt "\n", ##__VA_ARGS__)
+
+typedef struct {
+  const char *png_path; /* NULL: render to memory only */
+  const char *windows_path;
+  const char *theme;
+  double scale;
+  int repeat;
+  bool cold; /* Empty the card cache before every repeat */
+} Options;
+
+static void usage(void) {
+  fprintf(stderr,
+          "Usage: wswitch [--render-png out.png] --windows fixture.json\n"
+          "               [--theme name|file.ini] [--scale S] [--repeat N]\n"
+          "               [--cold]\n");
+}
+
+static int parse_options(int argc, char **argv, Options *opt) {
+  opt->png_path = NULL;
+  opt->windows_path = NULL;
+  opt->theme = NULL;
+  opt->scale = 1.0;
+  opt->repeat = 1;
+  opt->cold = false;
+
+  for (int i = 0; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (strcmp(arg, "--cold") == 0) {
+      opt->cold = true;
+      continue;
+    }
+    if (!val) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return -1;
+    }
+
+    if (strcmp(arg, "--render-png") == 0) {
+      opt->png_path = val;
+    } else if (strcmp(arg, "--windows") == 0) {
+      opt->windows_path = val;
+    } else if (strcmp(arg, "--theme") == 0) {
+      opt->theme = val;
+    } else if (strcmp(arg, "--scale") == 0) {
+      opt->scale = atof(val);
+    } else if (strcmp(arg, "--repeat") == 0) {
+      opt->repeat = atoi(val);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      return -1;
+    }
+    i++;
+  }
+
+  if (!opt->windows_path) {
+    fprintf(stderr, "--windows is required\n");
+    return -1;
+  }
+  if (opt->scale <= 0 || opt->repeat < 1) {
+    fprintf(stderr, "--scale and --repeat must be positive\n");
+    return -1;
+  }
+  return 0;
+}
+
+static int compare_ms(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static int write_png(const char *path, unsigned char *data, uint32_t width,
+                     uint32_t height, int stride) {
+  cairo_surface_t *surf = cairo_image_surface_create_for_data(
+      data, CAIRO_FORMAT_ARGB32, width, height, stride);
+  cairo_status_t status = cairo_surface_write_to_png(surf, path);
+  cairo_surface_destroy(surf);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    LOG("Failed to write %s: %s", path, cairo_status_to_string(status));
+    return -1;
+  }
+  return 0;
+}
+
+/* Render the fixture; times[0] is the first frame, with empty caches */
+static void render_frames(const Options *opt, Config *cfg, AppState *state,
+                          unsigned char *data, uint32_t width,
+                          uint32_t height, int stride, double *times) {
+  for (int i = 0; i < opt->repeat; i++) {
+    if (opt->cold && i > 0)
+      render_set_config(cfg); /* Drops cached cards */
+    times[i] = render_to_memory(state, data, width, height, stride);
+  }
+}
+
+static void print_timing(const Options *opt, const AppState *state,
+                         uint32_t width, uint32_t height, double *times) {
+  printf("render: %d windows, %ux%u px at %.2fx, theme %s\n", state->count,
+         width, height, opt->scale, opt->theme ? opt->theme : "(default)");
+  printf("  first    %8.3f ms\n", times[0]);
+  if (opt->repeat < 2)
+    return;
+
+  /* Frames after the first, sorted for percentiles */
+  int n = opt->repeat - 1;
+  double *rest = times + 1;
+  double sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += rest[i];
+  qsort(rest, n, sizeof(double), compare_ms);
+
+  printf("  repeat   %d frames%s\n", n, opt->cold ? " (cold caches)" : "");
+  printf("  mean     %8.3f ms\n", sum / n);
+  printf("  min      %8.3f ms\n", rest[0]);
+  printf("  p50      %8.3f ms\n", rest[n / 2]);
+  printf("  p99      %8.3f ms\n", rest[(n * 99) / 100]);
+  printf("  max      %8.3f ms\n", rest[n - 1]);
+}
+
+int headless_run(int argc, char **argv) {
+  Options opt;
+  if (parse_options(argc, argv, &opt) < 0) {
+    usage();
+    return 1;
+  }
+
+  Config *cfg = get_default_config();
+  if (!cfg)
+    return 1;
+  if (opt.theme && config_load_theme(cfg, opt.theme) < 0) {
+    fprintf(stderr, "Theme not found: %s\n", opt.theme);
+    free_config(cfg);
+    return 1;
+  }
+
+  AppState state;
+  app_state_init(&state);
+  if (fixture_load(opt.windows_path, &state) < 0) {
+    app_state_free(&state);
+    free_config(cfg);
+    return 1;
+  }
+
+  uint32_t scale120 = (uint32_t)lround(opt.scale * 120);
+  render_set_config(cfg);
+  render_set_scale(scale120);
+  icons_init(cfg->icon_theme, cfg->icon_fallback);
+
+  /* Logical size as the daemon would request it, then device pixels */
+  calculate_dimensions(&state, &state.width, &state.height);
+  uint32_t width = (state.width * scale120 + 60) / 120;
+  uint32_t height = (state.height * scale120 + 60) / 120;
+  int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+
+  unsigned char *data = calloc((size_t)stride, height);
+  double *times = calloc(opt.repeat, sizeof(double));
+  int rc = 1;
+  if (data && times) {
+    render_frames(&opt, cfg, &state, data, width, height, stride, times);
+    print_timing(&opt, &state, width, height, times);
+    rc = 0;
+    if (opt.png_path) {
+      if (write_png(opt.png_path, data, width, height, stride) < 0)
+        rc = 1;
+      else
+        printf("wrote %s\n", opt.png_path);
+    }
+  } else {
+    LOG("Out of memory for a %ux%u frame", width, height);
+  }
+
+  free(times);
+  free(data);
+  render_cleanup();
+  icons_cleanup();
+  app_state_free(&state);
+  free_config(cfg);
+  return rc;
+}
@@ -0,0 +1,11 @@
+/* src/headless.h - Offscreen Rendering Without a Compositor */
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/* Handle wswitch --render-png/--windows/--theme/--scale/--repeat/--cold:
+ * render a fixture offscreen through the normal drawing code, print
+ * timings and optionally write a PNG. argv[0] is the first option.
+ * Returns the process exit status. */
+int headless_run(int argc, char **argv);
+
+#endif /* HEADLESS_H */
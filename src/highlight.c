@@ -0,0 +1,199 @@
+/* src/highlight.c - Selection Highlight Subsurface
+ *
+ * The selected card's border and tint live in a small buffer on a
+ * synchronized subsurface above the grid. The grid buffer then draws
+ * every card the same way, and moving the selection within the rows on
+ * screen is a wl_subsurface.set_position plus a commit of the panel, with
+ * no pixels drawn. The highlight is rasterized again only when the card
+ * size, output scale or theme changes.
+ *
+ * Subsurface positions are whole logical pixels. At fractional scales the
+ * remainder is drawn into the buffer, so the highlight lands on the same
+ * device pixels as the card below it.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "highlight.h"
+#include "buffer_pool.h"
+#include "render.h"
+#include "sprites.h"
+#include "viewporter-client-protocol.h"
+#include <cairo/cairo.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Highlight] " fmt "\n", ##__VA_ARGS__)
+
+/* Opacity of the selected color laid over the card */
+#define HIGHLIGHT_TINT 0.3
+
+static struct wl_surface *hl_surface = NULL;
+static struct wl_subsurface *subsurface = NULL;
+static struct wp_viewport *hl_viewport = NULL;
+static BufferPool pool;
+static bool pool_ready = false;
+
+/* What the attached buffer shows; anything else needs a new one */
+typedef struct {
+  int w; /* Card size in buffer pixels */
+  int h;
+  int ox; /* Card offset inside the buffer (margin + remainder) */
+  int oy;
+  uint32_t scale120;
+  uint32_t card_selected;
+  uint32_t border_color;
+  int card_radius;
+  int border_width;
+} HighlightKey;
+
+static HighlightKey drawn;
+static bool attached = false; /* drawn is on the surface */
+
+bool highlight_attach(struct wl_surface *parent) {
+  if (hl_surface)
+    return true;
+  if (!compositor || !subcompositor || !parent)
+    return false;
+
+  hl_surface = wl_compositor_create_surface(compositor);
+  subsurface =
+      wl_subcompositor_get_subsurface(subcompositor, hl_surface, parent);
+  /* Synchronized (the default): position and buffer change atomically
+   * with the panel's own commit */
+  wl_subsurface_place_above(subsurface, parent);
+
+  /* Pointer input goes to the card underneath */
+  struct wl_region *empty = wl_compositor_create_region(compositor);
+  wl_surface_set_input_region(hl_surface, empty);
+  wl_region_destroy(empty);
+
+  if (viewporter)
+    hl_viewport = wp_viewporter_get_viewport(viewporter, hl_surface);
+  if (!pool_ready) {
+    buffer_pool_init(&pool, shm);
+    pool_ready = true;
+  }
+  attached = false;
+  LOG("Selection drawn on a subsurface");
+  return true;
+}
+
+void highlight_detach(void) {
+  if (hl_viewport) {
+    wp_viewport_destroy(hl_viewport);
+    hl_viewport = NULL;
+  }
+  if (subsurface) {
+    wl_subsurface_destroy(subsurface);
+    subsurface = NULL;
+  }
+  if (hl_surface) {
+    wl_surface_destroy(hl_surface);
+    hl_surface = NULL;
+  }
+  if (pool_ready) {
+    buffer_pool_finish(&pool);
+    pool_ready = false;
+  }
+  attached = false;
+}
+
+bool highlight_active(void) { return hl_surface != NULL; }
+
+static void set_source_color(cairo_t *cr, uint32_t color, double alpha) {
+  double r, g, b;
+  color_to_rgb(color, &r, &g, &b);
+  cairo_set_source_rgba(cr, r, g, b, alpha);
+}
+
+/* Rasterize k into a free buffer and attach it; lw x lh is the surface
+ * size in logical pixels */
+static bool draw_highlight(const HighlightKey *k, int lw, int lh) {
+  /* Device pixels; the viewport maps them back onto lw x lh */
+  uint32_t bw = (uint32_t)lround(lw * k->scale120 / 120.0);
+  uint32_t bh = (uint32_t)lround(lh * k->scale120 / 120.0);
+  ShmBuffer *buf = buffer_pool_acquire(&pool, bw, bh);
+  if (!buf)
+    return false;
+
+  cairo_surface_t *surf = cairo_image_surface_create_for_data(
+      buf->data, CAIRO_FORMAT_ARGB32, bw, bh, buf->stride);
+  cairo_t *cr = cairo_create(surf);
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_rgba(cr, 0, 0, 0, 0);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+  /* Same geometry as the selected card sprite */
+  set_source_color(cr, k->card_selected, HIGHLIGHT_TINT);
+  draw_rounded_rect(cr, k->ox, k->oy, k->w, k->h, k->card_radius);
+  cairo_fill(cr);
+  if (k->border_width > 0) {
+    set_source_color(cr, k->border_color, 1.0);
+    cairo_set_line_width(cr, k->border_width);
+    draw_rounded_rect(cr, k->ox, k->oy, k->w, k->h, k->card_radius);
+    cairo_stroke(cr);
+  }
+
+  cairo_destroy(cr);
+  cairo_surface_flush(surf);
+  cairo_surface_destroy(surf);
+
+  if (hl_viewport)
+    wp_viewport_set_destination(hl_viewport, lw, lh);
+  wl_surface_attach(hl_surface, buf->wl_buffer, 0, 0);
+  wl_surface_damage_buffer(hl_surface, 0, 0, bw, bh);
+  buffer_pool_mark_busy(buf);
+  return true;
+}
+
+void highlight_show(const Config *cfg, int x, int y, int w, int h,
+                    uint32_t scale120) {
+  if (!hl_surface || !cfg)
+    return;
+  if (!hl_viewport)
+    scale120 = 120; /* The panel renders at 1x without a viewport too */
+
+  double s = scale120 / 120.0;
+  HighlightKey k;
+  memset(&k, 0, sizeof(k));
+  k.w = w;
+  k.h = h;
+  k.scale120 = scale120;
+  k.card_selected = cfg->card_selected;
+  k.border_color = cfg->border_color;
+  k.card_radius = (int)lround(cfg->card_radius * s);
+  k.border_width = (int)lround(cfg->border_width * s);
+
+  /* Room for the outer half of the border, plus the remainder of placing
+   * the buffer on a whole logical pixel */
+  int margin = k.border_width / 2 + 1;
+  int lx = (int)floor((x - margin) / s);
+  int ly = (int)floor((y - margin) / s);
+  k.ox = x - (int)lround(lx * s);
+  k.oy = y - (int)lround(ly * s);
+  int lw = (int)ceil((k.ox + w + margin) / s);
+  int lh = (int)ceil((k.oy + h + margin) / s);
+
+  if (!attached || memcmp(&k, &drawn, sizeof(k)) != 0) {
+    if (!draw_highlight(&k, lw, lh)) {
+      LOG("No free buffer for the highlight");
+      return;
+    }
+    drawn = k;
+    attached = true;
+  }
+
+  wl_subsurface_set_position(subsurface, lx, ly);
+  /* Cached until the panel commits */
+  wl_surface_commit(hl_surface);
+}
+
+void highlight_hide(void) {
+  if (!hl_surface || !attached)
+    return;
+  wl_surface_attach(hl_surface, NULL, 0, 0);
+  wl_surface_commit(hl_surface);
+  attached = false;
+}
@@ -0,0 +1,36 @@
+/* src/highlight.h - Selection Highlight Subsurface */
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-client.h>
+
+/* Shared Wayland objects (set by main.c) */
+extern struct wl_compositor *compositor;
+extern struct wl_subcompositor *subcompositor; /* NULL if unsupported */
+extern struct wp_viewporter *viewporter;       /* NULL if unsupported */
+
+/* Create the highlight subsurface above the panel surface. Returns false,
+ * leaving the highlight inactive, without wl_subcompositor. */
+bool highlight_attach(struct wl_surface *parent);
+
+/* Destroy the subsurface; call before the panel surface goes away */
+void highlight_detach(void);
+
+/* A subsurface exists and can show the selection */
+bool highlight_active(void);
+
+/* Put the highlight over a card: x, y, w and h are the card's rectangle
+ * in the panel's buffer pixels at scale120. Only rasterizes when the
+ * size, scale or theme changed; otherwise this just moves the
+ * subsurface. Takes effect with the panel's next commit. */
+void highlight_show(const Config *cfg, int x, int y, int w, int h,
+                    uint32_t scale120);
+
+/* Hide the highlight (nothing selected); takes effect with the panel's
+ * next commit */
+void highlight_hide(void);
+
+#endif /* HIGHLIGHT_H */
@@ -0,0 +1,106 @@
+/* src/hud.c - Debug Overlay
+ *
+ * A small box of frame and cache numbers drawn over the panel, so a slow
+ * switch can be diagnosed on the machine it happened on. It is painted
+ * last into the frame and damaged on every frame it is shown. When it is
+ * off nothing here runs and nothing is gathered for it.
+ */
+#include "hud.h"
+#include <math.h>
+#include <pango/pangocairo.h>
+#include <stdio.h>
+
+/* Box size in logical pixels; the text is clipped to it */
+#define HUD_WIDTH 210
+#define HUD_HEIGHT 84
+#define HUD_FONT_POINTS 8
+
+/* Render thread */
+static PangoFontDescription *font = NULL;
+static uint32_t font_scale = 0;
+
+static int scaled(double v, uint32_t scale120) {
+  return (int)lround(v * scale120 / 120.0);
+}
+
+Rect hud_rect(uint32_t width, uint32_t height, int margin, uint32_t scale120) {
+  Rect r = {margin + scaled(4, scale120), margin + scaled(4, scale120),
+            scaled(HUD_WIDTH, scale120), scaled(HUD_HEIGHT, scale120)};
+  if (r.x + r.w > (int)width)
+    r.w = (int)width - r.x;
+  if (r.y + r.h > (int)height)
+    r.h = (int)height - r.y;
+  if (r.w < 0)
+    r.w = 0;
+  if (r.h < 0)
+    r.h = 0;
+  return r;
+}
+
+static const PangoFontDescription *hud_font(uint32_t scale120) {
+  if (font && font_scale == scale120)
+    return font;
+  if (!font) {
+    font = pango_font_description_new();
+    pango_font_description_set_family(font, "Monospace");
+  }
+  pango_font_description_set_size(
+      font, (int)lround((double)HUD_FONT_POINTS * PANGO_SCALE * scale120 /
+                        120.0));
+  font_scale = scale120;
+  return font;
+}
+
+static double mib(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+void hud_draw(cairo_t *cr, const Rect *r, const HudStats *s,
+              uint32_t scale120) {
+  if (r->w <= 0 || r->h <= 0)
+    return;
+
+  char show[32];
+  if (s->show_ms >= 0)
+    snprintf(show, sizeof(show), "%.1f ms", s->show_ms);
+  else
+    snprintf(show, sizeof(show), "-");
+
+  char text[256];
+  snprintf(text, sizeof(text),
+           "frame %.2f ms  p99 %.2f ms\n"
+           "quality %s\n"
+           "show to commit %s\n"
+           "icons %lu hit  %lu miss\n"
+           "pool %d/%d busy  %.1f MiB  %d out",
+           s->last_ms, s->p99_ms, s->quality, show, s->icon_hits,
+           s->icon_misses, s->buffers_busy, s->buffers_allocated,
+           mib(s->pool_bytes), s->pools);
+
+  cairo_save(cr);
+  cairo_rectangle(cr, r->x, r->y, r->w, r->h);
+  cairo_clip(cr);
+
+  /* Opaque, so redrawing it over its last frame needs nothing below and
+   * never lets the desktop show through the panel */
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_rgb(cr, 0, 0, 0);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+  PangoLayout *layout = pango_cairo_create_layout(cr);
+  pango_layout_set_font_description(layout, hud_font(scale120));
+  pango_layout_set_text(layout, text, -1);
+  cairo_set_source_rgb(cr, 0.6, 1.0, 0.6);
+  int pad = scaled(4, scale120);
+  cairo_move_to(cr, r->x + pad, r->y + pad);
+  pango_cairo_show_layout(cr, layout);
+  g_object_unref(layout);
+
+  cairo_restore(cr);
+}
+
+void hud_cleanup(void) {
+  if (font)
+    pango_font_description_free(font);
+  font = NULL;
+  font_scale = 0;
+}
@@ -0,0 +1,36 @@
+/* src/hud.h - Debug Overlay */
+#ifndef HUD_H
+#define HUD_H
+
+#include "layout.h"
+#include <cairo/cairo.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* What the overlay shows, gathered by the main thread when a frame is
+ * handed to the render thread */
+typedef struct {
+  double last_ms; /* Render time of the previous frame */
+  double p99_ms;
+  double show_ms; /* Show request to first commit (< 0 = not yet) */
+  const char *quality; /* Tier the previous frame was drawn at */
+  unsigned long icon_hits; /* Icon cache lookups since the show */
+  unsigned long icon_misses;
+  int buffers_busy; /* Buffers of the current output's pool */
+  int buffers_allocated;
+  int pools;          /* Outputs with buffers allocated */
+  size_t pool_bytes;  /* Shared memory mapped by all pools */
+} HudStats;
+
+/* Where the overlay goes in a width x height buffer at scale120, in the
+ * top-left corner inside margin */
+Rect hud_rect(uint32_t width, uint32_t height, int margin, uint32_t scale120);
+
+/* Draw the overlay into r (from hud_rect), covering all of it */
+void hud_draw(cairo_t *cr, const Rect *r, const HudStats *s,
+              uint32_t scale120);
+
+/* Thread exit: free the font */
+void hud_cleanup(void);
+
+#endif /* HUD_H */
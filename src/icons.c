@@ -3,8 +3,10 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "icons.h"
+#include "downscale.h"
 #include <ctype.h>
 #include <dirent.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,7 +34,12 @@ typedef struct {
 static IconCacheEntry icon_cache[MAX_CACHE];
 static int cache_count = 0;
 static unsigned long lru_counter = 0; /* Global access counter */
+static unsigned long hits = 0;        /* Lookups answered by the cache */
+static unsigned long misses = 0;
 static char current_theme[64] = "Tela-dracula";
+/* Tile workers load icons concurrently; the cache and lookups are
+ * serialized, callers only ever get their own references */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
 static char fallback_theme_name[64] = "Tela-circle-dracula";
 
 /* XDG icon search paths */
@@ -170,7 +177,7 @@ static char *find_icon_in_theme(const char *theme, const char *icon_name,
                                 int size) {
   (void)size; /* Size hint not used currently */
 
-  static char path[MAX_PATH];
+  static _Thread_local char path[MAX_PATH];
   const char *extensions[] = {".svg", ".png", ".xpm"};
 
   const char *sizes[] = {"scalable", "512x512", "256x256", "128x128", "64x64",
@@ -241,7 +248,7 @@ static char *find_icon_in_theme(const char *theme, const char *icon_name,
 
 /* Scan directory for desktop file matching class name */
 static char *find_desktop_file_by_scan(const char *class_name) {
-  static char found_path[MAX_PATH];
+  static _Thread_local char found_path[MAX_PATH];
   char lowercase_class[128];
   to_lowercase(lowercase_class, class_name, sizeof(lowercase_class));
 
@@ -285,7 +292,7 @@ static char *find_desktop_file_by_scan(const char *class_name) {
 
 /* Extract Icon= from desktop file */
 static char *extract_icon_from_desktop(const char *desktop_path) {
-  static char icon_name[256];
+  static _Thread_local char icon_name[256];
   FILE *fp = fopen(desktop_path, "r");
   if (!fp)
     return NULL;
@@ -311,7 +318,7 @@ static char *extract_icon_from_desktop(const char *desktop_path) {
 
 /* Find icon name from desktop file for a class name */
 static char *find_desktop_icon(const char *class_name) {
-  static char icon_name[256];
+  static _Thread_local char icon_name[256];
   char desktop_path[MAX_PATH];
   char lowercase[128];
   to_lowercase(lowercase, class_name, sizeof(lowercase));
@@ -359,6 +366,82 @@ static char *find_desktop_icon(const char *class_name) {
   return icon_name;
 }
 
+/* Shrink src into a size x size icon with the area downscaler, centered
+ * on whole pixels. Returns NULL if the pixels are in a format it does not
+ * handle. */
+static cairo_surface_t *shrink_png_icon(cairo_surface_t *src, int size,
+                                        double scale) {
+  cairo_format_t format = cairo_image_surface_get_format(src);
+  if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24)
+    return NULL;
+
+  int src_w = cairo_image_surface_get_width(src);
+  int src_h = cairo_image_surface_get_height(src);
+  int w = (int)(src_w * scale + 0.5);
+  int h = (int)(src_h * scale + 0.5);
+  if (w < 1)
+    w = 1;
+  if (h < 1)
+    h = 1;
+
+  cairo_surface_t *scaled =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+  if (cairo_surface_status(scaled) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(scaled);
+    return NULL;
+  }
+
+  cairo_surface_flush(src);
+  cairo_surface_flush(scaled);
+  unsigned char *data = cairo_image_surface_get_data(scaled);
+  int stride = cairo_image_surface_get_stride(scaled);
+  unsigned char *dst = data + (size_t)((size - h) / 2) * stride +
+                       (size_t)((size - w) / 2) * 4;
+
+  if (downscale_argb32(downscale_best_kernel(),
+                       cairo_image_surface_get_data(src), src_w, src_h,
+                       cairo_image_surface_get_stride(src), dst, w, h,
+                       stride) < 0) {
+    cairo_surface_destroy(scaled);
+    return NULL;
+  }
+
+  /* RGB24 leaves the alpha byte undefined: the result is opaque */
+  if (format == CAIRO_FORMAT_RGB24) {
+    for (int y = 0; y < h; y++) {
+      uint32_t *row = (uint32_t *)(dst + (size_t)y * stride);
+      for (int x = 0; x < w; x++)
+        row[x] |= 0xff000000u;
+    }
+  }
+
+  cairo_surface_mark_dirty(scaled);
+  return scaled;
+}
+
+/* Scale src into a size x size icon with Cairo, centered */
+static cairo_surface_t *scale_png_icon(cairo_surface_t *src, int size,
+                                       double scale) {
+  int src_w = cairo_image_surface_get_width(src);
+  int src_h = cairo_image_surface_get_height(src);
+  cairo_surface_t *scaled =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+  cairo_t *cr = cairo_create(scaled);
+
+  double offset_x = (size - src_w * scale) / 2.0;
+  double offset_y = (size - src_h * scale) / 2.0;
+
+  cairo_translate(cr, offset_x, offset_y);
+  cairo_scale(cr, scale, scale);
+
+  cairo_set_source_surface(cr, src, 0, 0);
+  cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BEST);
+  cairo_paint(cr);
+
+  cairo_destroy(cr);
+  return scaled;
+}
+
 /* Load PNG icon with high-quality scaling */
 static cairo_surface_t *load_png_icon(const char *path, int size) {
   cairo_surface_t *surface = cairo_image_surface_create_from_png(path);
@@ -371,24 +454,18 @@ static cairo_surface_t *load_png_icon(const char *path, int size) {
   int orig_h = cairo_image_surface_get_height(surface);
 
   if (orig_w != size || orig_h != size) {
-    cairo_surface_t *scaled =
-        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
-    cairo_t *cr = cairo_create(scaled);
-
     double scale_x = (double)size / orig_w;
     double scale_y = (double)size / orig_h;
     double scale = (scale_x < scale_y) ? scale_x : scale_y;
-    double offset_x = (size - orig_w * scale) / 2.0;
-    double offset_y = (size - orig_h * scale) / 2.0;
-
-    cairo_translate(cr, offset_x, offset_y);
-    cairo_scale(cr, scale, scale);
 
-    cairo_set_source_surface(cr, surface, 0, 0);
-    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BEST);
-    cairo_paint(cr);
+    /* Themes mostly ship larger PNGs than we draw; upscaling is rare and
+     * is left to Cairo */
+    cairo_surface_t *scaled = NULL;
+    if (scale < 1.0)
+      scaled = shrink_png_icon(surface, size, scale);
+    if (!scaled)
+      scaled = scale_png_icon(surface, size, scale);
 
-    cairo_destroy(cr);
     cairo_surface_destroy(surface);
     return scaled;
   }
@@ -448,32 +525,31 @@ void icons_init(const char *theme_name, const char *fallback) {
   LOG("Initialized: theme=%s, fallback=%s", current_theme, fallback_theme_name);
 }
 
-/* Load app icon by class name */
-cairo_surface_t *load_app_icon(const char *class_name, int size) {
-  if (!class_name || !class_name[0])
-    return NULL;
-
-  /* Check cache first */
+/* Cached icon for a class and size (new reference, NULL for a class
+ * known to have none). Returns false on a miss. Call with cache_lock. */
+static bool lookup_cached(const char *class_name, int size,
+                          cairo_surface_t **surface) {
   for (int i = 0; i < cache_count; i++) {
     if (strcmp(icon_cache[i].class_name, class_name) == 0 &&
         icon_cache[i].size == size) {
-      if (icon_cache[i].surface) {
-        cairo_surface_reference(icon_cache[i].surface);
-        update_access_time(i);
-        return icon_cache[i].surface;
-      }
-      return NULL;
+      update_access_time(i);
+      *surface = icon_cache[i].surface;
+      if (*surface)
+        cairo_surface_reference(*surface);
+      return true;
     }
   }
+  return false;
+}
 
+/* Find and decode an icon. Touches no shared state (lookup buffers are
+ * per thread), so it runs without the lock. */
+static cairo_surface_t *load_icon_file(const char *class_name, int size) {
   char *icon_name = find_desktop_icon(class_name);
   LOG("Class '%s' -> icon '%s'", class_name, icon_name ? icon_name : "(null)");
 
-  if (!icon_name) {
-    /* Cache the fact that this icon doesn't exist */
-    add_to_cache(class_name, size, NULL);
+  if (!icon_name)
     return NULL;
-  }
 
   cairo_surface_t *surface = NULL;
 
@@ -518,25 +594,71 @@ cairo_surface_t *load_app_icon(const char *class_name, int size) {
     }
   }
 
-  /* Add to cache (will evict LRU if needed) */
-  add_to_cache(class_name, size, surface);
+  return surface;
+}
 
+/* Load app icon by class name */
+cairo_surface_t *load_app_icon(const char *class_name, int size) {
+  if (!class_name || !class_name[0])
+    return NULL;
+
+  cairo_surface_t *surface;
+  pthread_mutex_lock(&cache_lock);
+  bool hit = lookup_cached(class_name, size, &surface);
+  if (hit)
+    hits++;
+  else
+    misses++;
+  pthread_mutex_unlock(&cache_lock);
+  if (hit)
+    return surface;
+
+  /* Disk and decoding stay outside the lock, so tile workers loading
+   * different icons do not queue behind each other */
+  surface = load_icon_file(class_name, size);
+
+  pthread_mutex_lock(&cache_lock);
+  cairo_surface_t *cached;
+  if (lookup_cached(class_name, size, &cached)) {
+    /* Another thread loaded it meanwhile: keep the cached one */
+    if (surface)
+      cairo_surface_destroy(surface);
+    surface = cached;
+  } else {
+    /* Misses are cached too, as a NULL surface (evicts LRU if full) */
+    add_to_cache(class_name, size, surface);
+  }
+  pthread_mutex_unlock(&cache_lock);
   return surface;
 }
 
+void icons_get_stats(unsigned long *h, unsigned long *m) {
+  pthread_mutex_lock(&cache_lock);
+  if (h)
+    *h = hits;
+  if (m)
+    *m = misses;
+  pthread_mutex_unlock(&cache_lock);
+}
+
 /* Check if icon exists for app */
 bool has_app_icon(const char *class_name) {
-  if (!class_name)
+  if (!class_name || !class_name[0])
     return false;
 
   /* Check cache first */
+  pthread_mutex_lock(&cache_lock);
   for (int i = 0; i < cache_count; i++) {
     if (strcmp(icon_cache[i].class_name, class_name) == 0) {
       update_access_time(i);
-      return icon_cache[i].surface != NULL;
+      bool found = icon_cache[i].surface != NULL;
+      pthread_mutex_unlock(&cache_lock);
+      return found;
     }
   }
 
+  pthread_mutex_unlock(&cache_lock);
+
   cairo_surface_t *s = load_app_icon(class_name, 48);
   if (s) {
     cairo_surface_destroy(s);
@@ -11,6 +11,9 @@ void icons_init(const char *theme_name, const char *fallback_theme);
 /* Load an app icon by class name (returns NULL if not found) */
 cairo_surface_t *load_app_icon(const char *class_name, int size);
 
+/* Lookup counters since startup (misses went to the theme) */
+void icons_get_stats(unsigned long *hits, unsigned long *misses);
+
 /* Free all cached icons */
 void icons_cleanup(void);
 
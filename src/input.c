@@ -1,10 +1,11 @@
-/* src/input.c - Keyboard Input Implementation */
+/* src/input.c - Keyboard and Pointer Input Implementation */
 #define _POSIX_C_SOURCE 200809L
 
 #include "input.h"
 #include "backend.h"
 #include "render.h"
 #include <fcntl.h>
+#include <linux/input-event-codes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,8 +25,17 @@ static bool ignore_first_release = true;
 
 modifier_release_callback_t on_modifier_release = NULL;
 modifier_release_callback_t on_escape = NULL;
+modifier_release_callback_t on_click = NULL;
 static AppState *app_state = NULL;
 
+/* Last pointer position on the panel, in surface coordinates. Hover only
+ * follows real motion, so a panel opening under a resting pointer keeps
+ * its selection. */
+static bool pointer_inside = false;
+static bool pointer_moved = false;
+static double pointer_x = 0;
+static double pointer_y = 0;
+
 extern Backend *backend;
 
 void input_reset_modifier_states(void) {
@@ -120,7 +130,7 @@ static void keyboard_key(void *data, struct wl_keyboard *keyboard,
         if (app_state->selected_index >= app_state->count)
           app_state->selected_index = 0;
       }
-      render_ui(app_state, app_state->width, app_state->height);
+      render_schedule(app_state);
     }
     break;
 
@@ -201,6 +211,99 @@ const struct wl_keyboard_listener *get_keyboard_listener(void) {
   return &keyboard_listener;
 }
 
+static void pointer_enter(void *data, struct wl_pointer *pointer,
+                          uint32_t serial, struct wl_surface *surface,
+                          wl_fixed_t x, wl_fixed_t y) {
+  (void)pointer;
+  (void)serial;
+  (void)surface;
+  app_state = (AppState *)data;
+  pointer_inside = true;
+  pointer_moved = false;
+  pointer_x = wl_fixed_to_double(x);
+  pointer_y = wl_fixed_to_double(y);
+}
+
+static void pointer_leave(void *data, struct wl_pointer *pointer,
+                          uint32_t serial, struct wl_surface *surface) {
+  (void)data;
+  (void)pointer;
+  (void)serial;
+  (void)surface;
+  pointer_inside = false;
+  pointer_moved = false;
+}
+
+static void pointer_motion(void *data, struct wl_pointer *pointer,
+                           uint32_t time, wl_fixed_t x, wl_fixed_t y) {
+  (void)data;
+  (void)pointer;
+  (void)time;
+  pointer_x = wl_fixed_to_double(x);
+  pointer_y = wl_fixed_to_double(y);
+  pointer_moved = true;
+}
+
+/* Card under the pointer, or -1 */
+static int hovered_card(void) {
+  if (!pointer_inside || !app_state)
+    return -1;
+  return render_hit_test(app_state, pointer_x, pointer_y);
+}
+
+void input_dispatch_pointer(void) {
+  if (!pointer_moved)
+    return;
+  pointer_moved = false;
+
+  /* Only a different card changes anything; render_schedule() then
+   * draws at most once per frame however often this runs */
+  int i = hovered_card();
+  if (i >= 0 && i != app_state->selected_index) {
+    app_state->selected_index = i;
+    render_schedule(app_state);
+  }
+}
+
+static void pointer_button(void *data, struct wl_pointer *pointer,
+                           uint32_t serial, uint32_t time, uint32_t button,
+                           uint32_t state_w) {
+  (void)data;
+  (void)pointer;
+  (void)serial;
+  (void)time;
+  if (button != BTN_LEFT || state_w != WL_POINTER_BUTTON_STATE_PRESSED)
+    return;
+
+  int i = hovered_card();
+  if (i < 0)
+    return;
+  app_state->selected_index = i;
+  if (on_click)
+    on_click();
+}
+
+static void pointer_axis(void *data, struct wl_pointer *pointer,
+                         uint32_t time, uint32_t axis, wl_fixed_t value) {
+  (void)data;
+  (void)pointer;
+  (void)time;
+  (void)axis;
+  (void)value;
+}
+
+static const struct wl_pointer_listener pointer_listener = {
+    .enter = pointer_enter,
+    .leave = pointer_leave,
+    .motion = pointer_motion,
+    .button = pointer_button,
+    .axis = pointer_axis,
+};
+
+const struct wl_pointer_listener *get_pointer_listener(void) {
+  return &pointer_listener;
+}
+
 void input_cleanup(void) {
   if (xkb_st)
     xkb_state_unref(xkb_st);
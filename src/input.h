@@ -1,4 +1,4 @@
-/* src/input.h - Keyboard Input Handling */
+/* src/input.h - Keyboard and Pointer Input Handling */
 #ifndef INPUT_H
 #define INPUT_H
 
@@ -13,12 +13,24 @@ extern modifier_release_callback_t on_modifier_release;
 /* Callback for Escape key - hide without switching (set by main.c) */
 extern modifier_release_callback_t on_escape;
 
+/* Callback for a click on a card, which is selected first (set by
+ * main.c) */
+extern modifier_release_callback_t on_click;
+
 /* Reset modifier states (call when switcher shows to avoid stale detection) */
 void input_reset_modifier_states(void);
 
 /* Get keyboard listener for Wayland seat */
 const struct wl_keyboard_listener *get_keyboard_listener(void);
 
+/* Get pointer listener for Wayland seat */
+const struct wl_pointer_listener *get_pointer_listener(void);
+
+/* Select the card under the pointer if it moved since the last call.
+ * Motion events only store the position, so call this once per event
+ * loop iteration: a burst of them costs a single hit test. */
+void input_dispatch_pointer(void);
+
 /* Cleanup input resources */
 void input_cleanup(void);
 
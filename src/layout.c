@@ -0,0 +1,126 @@
+/* src/layout.c - Card Grid Layout
+ *
+ * One place decides how many columns and rows the grid gets and where
+ * each card goes. The surface size, drawing, damage and pointer hits all
+ * come from these numbers, so they cannot disagree about the grid. The
+ * shape is picked once in logical pixels; layouts in buffer pixels reuse
+ * it so both scales place the same card in the same cell.
+ */
+#include "layout.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Cells of size + gap that fit in span, at least one */
+static int cells_fitting(int span, int size, int gap) {
+  int n = size + gap > 0 ? (span + gap) / (size + gap) : 1;
+  return n > 1 ? n : 1;
+}
+
+void layout_fit(const LayoutMetrics *m, int count, int *columns,
+                int *visible_rows, int *width, int *height) {
+  int n = count > 0 ? count : 1;
+  int frame = 2 * (m->padding + m->margin);
+
+  int cols = m->max_cols > 0 ? m->max_cols : 1;
+  if (n < cols)
+    cols = n;
+  /* Narrow outputs get fewer columns rather than a clipped panel */
+  if (m->avail_w > 0) {
+    int fit = cells_fitting(m->avail_w - frame, m->card_w, m->gap);
+    if (cols > fit)
+      cols = fit;
+  }
+
+  /* Further rows scroll instead of growing the panel past the output */
+  int rows = (n + cols - 1) / cols;
+  if (m->max_rows > 0 && rows > m->max_rows)
+    rows = m->max_rows;
+  if (m->avail_h > 0) {
+    int fit = cells_fitting(m->avail_h - frame, m->card_h, m->gap);
+    if (rows > fit)
+      rows = fit;
+  }
+
+  *columns = cols;
+  *visible_rows = rows;
+  if (width)
+    *width = cols * m->card_w + (cols - 1) * m->gap + frame;
+  if (height)
+    *height = rows * m->card_h + (rows - 1) * m->gap + frame;
+}
+
+int layout_build(Layout *l, const LayoutMetrics *m, int count, int columns,
+                 int visible_rows, int width, int height) {
+  if (columns <= 0)
+    layout_fit(m, count, &columns, &visible_rows, NULL, NULL);
+
+  if (count > l->capacity) {
+    Rect *cards = realloc(l->cards, count * sizeof(Rect));
+    if (!cards) {
+      layout_free(l);
+      return -1;
+    }
+    l->cards = cards;
+    l->capacity = count;
+  }
+
+  l->count = count;
+  l->columns = columns;
+  l->total_rows = (count + columns - 1) / columns;
+  l->visible_rows = visible_rows;
+  if (l->visible_rows <= 0 || l->visible_rows > l->total_rows)
+    l->visible_rows = l->total_rows;
+  l->card_w = m->card_w;
+  l->card_h = m->card_h;
+  l->gap = m->gap;
+  l->width = width;
+  l->height = height;
+
+  int cols = count < columns ? count : columns;
+  int grid_w = cols * m->card_w + (cols - 1) * m->gap;
+  int grid_h = l->visible_rows * m->card_h + (l->visible_rows - 1) * m->gap;
+
+  /* Centered on whole pixels, so cached cards can be blitted without
+   * resampling */
+  int pad = m->margin + m->padding;
+  l->grid_x = width > grid_w ? (width - grid_w) / 2 : 0;
+  l->grid_y = height > grid_h ? (height - grid_h) / 2 : 0;
+  if (l->grid_x < pad)
+    l->grid_x = pad;
+  if (l->grid_y < pad)
+    l->grid_y = pad;
+
+  for (int i = 0; i < count; i++) {
+    Rect *r = &l->cards[i];
+    r->x = l->grid_x + (i % columns) * (m->card_w + m->gap);
+    r->y = l->grid_y + (i / columns) * (m->card_h + m->gap);
+    r->w = m->card_w;
+    r->h = m->card_h;
+  }
+  return 0;
+}
+
+int layout_hit_test(const Layout *l, int first_row, int x, int y) {
+  if (l->count == 0 || x < l->grid_x || y < l->grid_y)
+    return -1;
+
+  /* The cell under the point is the only card that can contain it */
+  int col = (x - l->grid_x) / (l->card_w + l->gap);
+  int row = (y - l->grid_y) / (l->card_h + l->gap);
+  if (col >= l->columns || row >= l->visible_rows)
+    return -1;
+
+  int i = (first_row + row) * l->columns + col;
+  if (i < 0 || i >= l->count)
+    return -1;
+
+  Rect r = layout_card(l, i, first_row);
+  if (x >= r.x + r.w || y >= r.y + r.h)
+    return -1; /* In the gap after the card */
+  return i;
+}
+
+void layout_free(Layout *l) {
+  free(l->cards);
+  memset(l, 0, sizeof(Layout));
+}
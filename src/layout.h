@@ -0,0 +1,73 @@
+/* src/layout.h - Card Grid Layout */
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+
+/* Pixel rectangle in the layout's coordinates */
+typedef struct {
+  int x;
+  int y;
+  int w;
+  int h;
+} Rect;
+
+/* Sizes in whatever pixel unit the layout is built in (logical for the
+ * surface size, buffer pixels for drawing) */
+typedef struct {
+  int card_w;
+  int card_h;
+  int gap;
+  int padding;  /* Between the panel edge and the cards */
+  int margin;   /* Transparent border around the panel for its shadow */
+  int max_cols; /* Upper bound from the config */
+  int max_rows; /* Visible rows before scrolling (0 = unlimited) */
+  int avail_w;  /* Room on the output for the panel (0 = unbounded) */
+  int avail_h;
+} LayoutMetrics;
+
+/* Card rectangles for one window list in one panel. Rebuilt when the
+ * list, the panel size or the scale changes; selection and scrolling
+ * only read it. */
+typedef struct {
+  int count;
+  int columns;
+  int total_rows;
+  int visible_rows;
+  int card_w;
+  int card_h;
+  int gap;
+  int width; /* Panel size, margin included */
+  int height;
+  int grid_x; /* Top-left card when scrolled to the top */
+  int grid_y;
+  Rect *cards; /* count entries, positioned with row 0 at grid_y */
+  int capacity;
+} Layout;
+
+/* Pick the grid shape for count cards: columns and visible rows shrink to
+ * what fits on the output. Also returns the panel size (0 to skip). */
+void layout_fit(const LayoutMetrics *m, int count, int *columns,
+                int *visible_rows, int *width, int *height);
+
+/* Place count cards in a width x height panel with the given shape
+ * (columns <= 0 picks one with layout_fit). Returns 0, or -1 if out of
+ * memory, leaving the layout empty. */
+int layout_build(Layout *l, const LayoutMetrics *m, int count, int columns,
+                 int visible_rows, int width, int height);
+
+/* Card i with first_row scrolled to the top of the grid */
+static inline Rect layout_card(const Layout *l, int i, int first_row) {
+  Rect r = l->cards[i];
+  r.y -= first_row * (l->card_h + l->gap);
+  return r;
+}
+
+/* Card under a point with first_row at the top, or -1 (gaps, padding and
+ * rows scrolled out of view included) */
+int layout_hit_test(const Layout *l, int first_row, int x, int y);
+
+/* Release the card table */
+void layout_free(Layout *l);
+
+#endif /* LAYOUT_H */
@@ -0,0 +1,18 @@
+/* src/list_view.h - Compact List Rows */
+#ifndef LIST_VIEW_H
+#define LIST_VIEW_H
+
+#include "config.h"
+#include "data.h"
+#include "layout.h"
+#include <cairo/cairo.h>
+#include <stdbool.h>
+
+/* Draw one row of the list view straight onto cr: highlight when
+ * selected, a small icon, the title and the group count. Lengths in cfg
+ * and row are buffer pixels, text_size is in Pango units. Only pixels
+ * inside row are touched, so a row can be redrawn on its own. */
+void list_view_draw_row(cairo_t *cr, const Config *cfg, const WindowInfo *win,
+                        const Rect *row, bool selected, int text_size);
+
+#endif /* LIST_VIEW_H */
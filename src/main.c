@@ -2,11 +2,20 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "backend.h"
+#include "bench.h"
+#include "card_cache.h"
 #include "config.h"
+#include "fractional-scale-v1-client-protocol.h"
+#include "headless.h"
+#include "highlight.h"
 #include "icons.h"
 #include "input.h"
+#include "outputs.h"
 #include "render.h"
 #include "socket.h"
+#include "stats.h"
+#include "thumbnails.h"
+#include "viewporter-client-protocol.h"
 #include "wlr-layer-shell-unstable-v1-client-protocol.h"
 #include "xdg-shell-client-protocol.h"
 
@@ -17,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <time.h>
@@ -34,12 +44,26 @@
 /* Global State */
 struct wl_display *display = NULL;
 struct wl_compositor *compositor = NULL;
+struct wl_subcompositor *subcompositor = NULL;
 struct wl_shm *shm = NULL;
 struct zwlr_layer_shell_v1 *layer_shell = NULL;
 struct wl_surface *surface = NULL;
 struct zwlr_layer_surface_v1 *layer_surface = NULL;
 struct wl_seat *seat = NULL;
 struct wl_keyboard *keyboard = NULL;
+struct wl_pointer *pointer = NULL;
+
+/* Output slot frames are sized and scaled for: the one the panel is on,
+ * or the one it is about to open on (-1 = unknown) */
+static int panel_output = -1;
+/* Output the panel surface was opened on or entered (-1 = not known) */
+static int surface_output = -1;
+
+/* HiDPI: both are optional, the panel renders at 1x without them */
+struct wp_fractional_scale_manager_v1 *fractional_scale_manager = NULL;
+struct wp_viewporter *viewporter = NULL;
+struct wp_fractional_scale_v1 *fractional_scale = NULL;
+struct wp_viewport *viewport = NULL;
 
 static bool running = true;
 static bool visible = false;
@@ -50,6 +74,14 @@ static int socket_fd = -1;
 
 Backend *backend = NULL;
 
+/* Speculative pre-render: backend changes while hidden are debounced, then
+ * the panel the next show is expected to open with is drawn ahead */
+#define PRERENDER_DELAY_MS 150
+static bool prerender_pending = false;
+static struct timespec prerender_due;
+static void schedule_prerender(void);
+static void destroy_panel(void);
+
 /* Signal Handling */
 static volatile sig_atomic_t should_quit = 0;
 static void signal_handler(int sig) {
@@ -75,7 +107,7 @@ static void layer_surface_configure(void *data,
   zwlr_layer_surface_v1_ack_configure(layer_surf, serial);
 
   if (visible) {
-    render_ui(&app_state, app_state.width, app_state.height);
+    render_schedule(&app_state);
   }
 }
 
@@ -83,8 +115,10 @@ static void layer_surface_closed(void *data,
                                  struct zwlr_layer_surface_v1 *layer_surf) {
   (void)data;
   (void)layer_surf;
+  /* Its output went away; the next show opens a new one */
   LOG("Layer surface closed by compositor");
-  should_quit = 1;
+  destroy_panel();
+  schedule_prerender();
 }
 
 static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
@@ -92,6 +126,25 @@ static const struct zwlr_layer_surface_v1_listener layer_surface_listener = {
     .closed = layer_surface_closed,
 };
 
+static void fractional_scale_preferred(void *data,
+                                       struct wp_fractional_scale_v1 *scale,
+                                       uint32_t scale120) {
+  (void)data;
+  (void)scale;
+  /* Remembered, so the next panel on this output starts at this scale */
+  Output *out = outputs_get(panel_output);
+  if (out)
+    out->scale120 = scale120;
+  render_set_scale(scale120);
+  thumbnails_set_scale(scale120);
+  if (visible)
+    render_schedule(&app_state);
+}
+
+static const struct wp_fractional_scale_v1_listener scale_listener = {
+    .preferred_scale = fractional_scale_preferred,
+};
+
 static void seat_capabilities(void *data, struct wl_seat *wl_seat,
                               uint32_t caps) {
   (void)wl_seat;
@@ -101,6 +154,11 @@ static void seat_capabilities(void *data, struct wl_seat *wl_seat,
     wl_keyboard_add_listener(keyboard, get_keyboard_listener(), state);
     LOG("Keyboard listener attached");
   }
+  if ((caps & WL_SEAT_CAPABILITY_POINTER) && !pointer) {
+    pointer = wl_seat_get_pointer(seat);
+    wl_pointer_add_listener(pointer, get_pointer_listener(), state);
+    LOG("Pointer listener attached");
+  }
 }
 
 static void seat_name(void *data, struct wl_seat *wl_seat, const char *name) {
@@ -117,11 +175,13 @@ static const struct wl_seat_listener seat_listener = {
 static void registry_global(void *data, struct wl_registry *registry,
                             uint32_t name, const char *interface,
                             uint32_t version) {
-  (void)version;
   AppState *state = (AppState *)data;
 
   if (strcmp(interface, wl_compositor_interface.name) == 0)
     compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+  else if (strcmp(interface, wl_subcompositor_interface.name) == 0)
+    subcompositor =
+        wl_registry_bind(registry, name, &wl_subcompositor_interface, 1);
   else if (strcmp(interface, wl_shm_interface.name) == 0)
     shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
   else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0)
@@ -130,23 +190,133 @@ static void registry_global(void *data, struct wl_registry *registry,
   else if (strcmp(interface, wl_seat_interface.name) == 0) {
     seat = wl_registry_bind(registry, name, &wl_seat_interface, 4);
     wl_seat_add_listener(seat, &seat_listener, state);
-  }
+  } else if (strcmp(interface, wp_fractional_scale_manager_v1_interface.name) ==
+             0)
+    fractional_scale_manager = wl_registry_bind(
+        registry, name, &wp_fractional_scale_manager_v1_interface, 1);
+  else if (strcmp(interface, wp_viewporter_interface.name) == 0)
+    viewporter = wl_registry_bind(registry, name, &wp_viewporter_interface, 1);
+  else if (!outputs_bind(registry, name, interface, version))
+    thumbnails_bind(registry, name, interface, version);
 }
 
 static void registry_global_remove(void *data, struct wl_registry *registry,
                                    uint32_t name) {
   (void)data;
   (void)registry;
-  (void)name;
-  LOG("Registry global removed: %u (compositor may be exiting)", name);
+  LOG("Registry global removed: %u", name);
+  outputs_remove(name);
 }
 
 static const struct wl_registry_listener registry_listener = {
     .global = registry_global, .global_remove = registry_global_remove};
 
+/* --- Outputs --- */
+
+/* Size and scale frames for an output before anything is drawn for it,
+ * and render into that output's buffers */
+static void use_output(int slot) {
+  Output *out = outputs_get(slot);
+  panel_output = out ? slot : -1;
+  render_set_output(panel_output);
+  if (!out)
+    return;
+
+  int w, h;
+  outputs_logical_size(out, &w, &h);
+  render_set_output_size(w, h);
+  /* Buffers only exceed 1x with both scale protocols */
+  if (fractional_scale_manager && viewporter)
+    render_set_scale(outputs_scale120(out));
+}
+
+/* Output the config opens the panel on, or -1 for the compositor's pick */
+static int pick_output(void) {
+  const char *want = config ? config->output : "auto";
+  if (strcasecmp(want, "auto") == 0)
+    return -1;
+  if (strcasecmp(want, "focused") == 0) {
+    struct wl_output *active = NULL;
+    if (backend && backend->get_active_output)
+      active = backend->get_active_output();
+    return outputs_find(active);
+  }
+  return outputs_find_name(want);
+}
+
+static void output_changed(int slot) {
+  /* Until the panel has been placed, the first output is the guess */
+  if (slot == panel_output || panel_output < 0)
+    use_output(slot);
+  schedule_prerender();
+}
+
+static void output_removed(int slot) {
+  render_forget_output(slot);
+  if (slot == surface_output)
+    surface_output = -1;
+  if (slot == panel_output)
+    use_output(-1);
+}
+
+/* The compositor put the panel somewhere else than predicted */
+static void surface_enter(void *data, struct wl_surface *wl_surface,
+                          struct wl_output *wl_output) {
+  (void)data;
+  (void)wl_surface;
+  int slot = outputs_find(wl_output);
+  if (slot < 0)
+    return;
+
+  surface_output = slot;
+  if (slot == panel_output)
+    return;
+  use_output(slot);
+  if (visible)
+    render_schedule(&app_state);
+}
+
+static void surface_leave(void *data, struct wl_surface *wl_surface,
+                          struct wl_output *wl_output) {
+  (void)data;
+  (void)wl_surface;
+  (void)wl_output;
+}
+
+static const struct wl_surface_listener surface_listener = {
+    .enter = surface_enter,
+    .leave = surface_leave,
+};
+
 /* --- Logic --- */
 
+/* Ask for the surface's preferred fractional scale. Buffers can only be
+ * larger than the surface with a viewport, so both protocols are needed. */
+static void attach_scale_objects(void) {
+  if (!surface || !fractional_scale_manager || !viewporter)
+    return;
+
+  viewport = wp_viewporter_get_viewport(viewporter, surface);
+  fractional_scale = wp_fractional_scale_manager_v1_get_fractional_scale(
+      fractional_scale_manager, surface);
+  wp_fractional_scale_v1_add_listener(fractional_scale, &scale_listener, NULL);
+}
+
+static void destroy_scale_objects(void) {
+  if (fractional_scale) {
+    wp_fractional_scale_v1_destroy(fractional_scale);
+    fractional_scale = NULL;
+  }
+  if (viewport) {
+    wp_viewport_destroy(viewport);
+    viewport = NULL;
+  }
+}
+
 static void destroy_panel(void) {
+  render_reset_frame_state();
+  highlight_detach();
+  destroy_scale_objects();
   if (layer_surface) {
     zwlr_layer_surface_v1_destroy(layer_surface);
     layer_surface = NULL;
@@ -159,7 +329,8 @@ static void destroy_panel(void) {
   LOG("Panel destroyed");
 }
 
-static void create_panel(void) {
+/* Open the panel on an output slot, or where the compositor likes (-1) */
+static void create_panel(int slot) {
   if (surface) {
     LOG("Panel already exists");
     return;
@@ -170,15 +341,20 @@ static void create_panel(void) {
     LOG("Failed to create surface");
     return;
   }
+  wl_surface_add_listener(surface, &surface_listener, NULL);
 
+  Output *out = outputs_get(slot);
   layer_surface = zwlr_layer_shell_v1_get_layer_surface(
-      layer_shell, surface, NULL, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "wswitch");
+      layer_shell, surface, out ? out->wl_output : NULL,
+      ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "wswitch");
   if (!layer_surface) {
     LOG("Failed to create layer surface");
     wl_surface_destroy(surface);
     surface = NULL;
     return;
   }
+  attach_scale_objects();
+  highlight_attach(surface);
 
   zwlr_layer_surface_v1_set_size(layer_surface, 1, 1); // 最小初始尺寸
   zwlr_layer_surface_v1_set_anchor(layer_surface, 0);
@@ -186,10 +362,81 @@ static void create_panel(void) {
   zwlr_layer_surface_v1_add_listener(layer_surface, &layer_surface_listener,
                                      NULL);
 
+  surface_output = out ? slot : -1;
+  if (out)
+    use_output(slot);
+
   wl_surface_commit(surface);
   wl_display_roundtrip(display);
 
-  LOG("Panel created");
+  LOG("Panel created on %s", out && out->name[0] ? out->name : "any output");
+}
+
+static void schedule_prerender(void) {
+  if (visible)
+    return;
+  clock_gettime(CLOCK_MONOTONIC, &prerender_due);
+  prerender_due.tv_nsec += PRERENDER_DELAY_MS * 1000000L;
+  if (prerender_due.tv_nsec >= 1000000000L) {
+    prerender_due.tv_sec++;
+    prerender_due.tv_nsec -= 1000000000L;
+  }
+  prerender_pending = true;
+}
+
+/* Milliseconds until the pre-render is due, -1 if none is pending */
+static int prerender_timeout(void) {
+  if (!prerender_pending || visible)
+    return -1;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long ms = (prerender_due.tv_sec - now.tv_sec) * 1000 +
+            (prerender_due.tv_nsec - now.tv_nsec) / 1000000;
+  return ms > 0 ? (int)ms : 0;
+}
+
+/* Fill state with the panel a show would open: current windows, the
+ * previous one selected, sized to fit */
+static int predict_panel(AppState *state) {
+  if (!backend) {
+    LOG("Error: Backend not initialized");
+    return -1;
+  }
+
+  if (backend->get_windows(state, config) < 0) {
+    LOG("Failed to update window list");
+    return -1;
+  }
+
+  state->selected_index = (state->count > 1) ? 1 : 0;
+  calculate_dimensions(state, &state->width, &state->height);
+  return 0;
+}
+
+/* A capture finished: redraw the card, or pre-render it while hidden */
+static void thumbnail_ready(const char *identifier) {
+  render_window_changed(identifier, NULL);
+  render_invalidate();
+  if (visible)
+    render_schedule(&app_state);
+  else
+    schedule_prerender();
+}
+
+static void prerender_panel(void) {
+  AppState predicted;
+  app_state_init(&predicted);
+
+  /* Drawn at the scale and into the buffers of where the show will open */
+  int target = pick_output();
+  if (target >= 0)
+    use_output(target);
+
+  prerender_pending = false;
+  if (predict_panel(&predicted) == 0 && !render_prerender(&predicted))
+    schedule_prerender(); /* Render thread busy: try again shortly */
+
+  app_state_free(&predicted);
 }
 
 static void hide_switcher(void) {
@@ -197,6 +444,9 @@ static void hide_switcher(void) {
     return;
 
   visible = false;
+  render_reset_frame_state();
+  card_cache_log_stats();
+  stats_log();
 
   if (config && config->follow_monitor) {
     destroy_panel();
@@ -206,19 +456,30 @@ static void hide_switcher(void) {
     wl_display_flush(display);
     LOG("Panel hidden (not destroyed)");
   }
+
+  /* The shown frame was used up; have the next one ready */
+  schedule_prerender();
 }
 
 static void show_switcher(void) {
   LOG("Showing switcher...");
 
-  if (config && config->follow_monitor && !surface) {
-    create_panel();
+  if (visible)
+    return;
+  render_note_show();
+
+  /* A layer surface cannot move: reopen it if it is on another output */
+  int target = pick_output();
+  if (surface && target >= 0 && target != surface_output)
+    destroy_panel();
+  if (!surface) {
+    create_panel(target);
     if (!surface) {
       LOG("Failed to create panel");
       return;
     }
-  } else if (visible) {
-    return;
+  } else if (target >= 0) {
+    use_output(target);
   }
 
   input_reset_modifier_states();
@@ -226,19 +487,16 @@ static void show_switcher(void) {
   app_state_free(&app_state);
   app_state_init(&app_state);
 
-  if (!backend) {
-    LOG("Error: Backend not initialized");
-    return;
-  }
-
-  if (backend->get_windows(&app_state, config) < 0) {
-    LOG("Failed to update window list");
+  if (predict_panel(&app_state) < 0)
     return;
-  }
 
-  app_state.selected_index = (app_state.count > 1) ? 1 : 0;
+  /* Cards show icons until these arrive; list rows never show them. Not
+   * done when pre-rendering, which finished captures trigger too */
+  if (config->mode != MODE_LIST)
+    thumbnails_request(&app_state);
 
-  calculate_dimensions(&app_state, &app_state.width, &app_state.height);
+  /* Usually matches the pre-rendered frame, which is then attached on the
+   * first configure instead of drawing */
   zwlr_layer_surface_v1_set_size(layer_surface, app_state.width,
                                  app_state.height);
   zwlr_layer_surface_v1_set_keyboard_interactivity(layer_surface, 1);
@@ -268,6 +526,13 @@ static void handle_command(const char *cmd) {
     return;
   }
 
+  if (strcmp(cmd, CMD_HUD) == 0) {
+    render_toggle_hud();
+    if (visible)
+      render_schedule(&app_state);
+    return;
+  }
+
   if (strcmp(cmd, CMD_TOGGLE) == 0) {
     if (visible)
       hide_switcher();
@@ -287,9 +552,10 @@ static void handle_command(const char *cmd) {
       dir = -1;
 
     if (dir != 0 && app_state.count > 0) {
+      /* Bursts only move the index; the next frame shows the net result */
       app_state.selected_index =
           (app_state.selected_index + dir + app_state.count) % app_state.count;
-      render_ui(&app_state, app_state.width, app_state.height);
+      render_schedule(&app_state);
     } else if (strcmp(cmd, CMD_SELECT) == 0) {
       select_and_hide();
     }
@@ -311,6 +577,8 @@ static int run_client(const char *cmd) {
     socket_cmd = CMD_HIDE;
   else if (strcmp(cmd, "quit") == 0)
     socket_cmd = CMD_QUIT;
+  else if (strcmp(cmd, "hud") == 0)
+    socket_cmd = CMD_HUD;
   else
     return 1;
 
@@ -346,11 +614,19 @@ static int run_daemon(void) {
     config = get_default_config();
   render_set_config(config);
   icons_init(config->icon_theme, config->icon_fallback);
+  render_init();
+  thumbnails_init(config);
   app_state_init(&app_state);
 
   /* Callbacks */
   on_modifier_release = select_and_hide;
   on_escape = hide_switcher; /* hide without switch */
+  on_click = select_and_hide;
+  on_window_changed = render_window_changed;
+  on_list_changed = schedule_prerender;
+  on_thumbnail_ready = thumbnail_ready;
+  on_output_changed = output_changed;
+  on_output_removed = output_removed;
 
   /* 3. Wayland Connection */
   for (int i = 0; i < WAYLAND_RETRY_MAX; i++) {
@@ -392,18 +668,9 @@ static int run_daemon(void) {
     return 1;
   }
 
-  /* 5. Surface Setup */
-  surface = wl_compositor_create_surface(compositor);
-  layer_surface = zwlr_layer_shell_v1_get_layer_surface(
-      layer_shell, surface, NULL, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, "wswitch");
-  zwlr_layer_surface_v1_set_size(layer_surface, 1,
-                                 1); /* Minimal initial size */
-  zwlr_layer_surface_v1_set_anchor(layer_surface, 0);
-  zwlr_layer_surface_v1_set_keyboard_interactivity(layer_surface, 0);
-  zwlr_layer_surface_v1_add_listener(layer_surface, &layer_surface_listener,
-                                     NULL);
-  wl_surface_commit(surface);
+  /* 5. Surface Setup (outputs are known after this roundtrip) */
   wl_display_roundtrip(display);
+  create_panel(pick_output());
 
   /* 6. Socket Server */
   socket_fd = init_server();
@@ -416,11 +683,14 @@ static int run_daemon(void) {
 
   LOG("Daemon Started (PID: %d)", getpid());
 
-  struct pollfd fds[2];
+  struct pollfd fds[3];
   fds[0].fd = wl_display_get_fd(display);
   fds[0].events = POLLIN | POLLERR | POLLHUP;
   fds[1].fd = socket_fd;
   fds[1].events = POLLIN;
+  fds[2].fd = render_get_fd(); /* -1 (ignored) without a render thread */
+  fds[2].events = POLLIN;
+  fds[2].revents = 0;
 
   while (running && !should_quit) {
     /* prepare to read Wayland events */
@@ -436,8 +706,13 @@ static int run_daemon(void) {
     } else {
       wl_display_flush(display);
 
-      /* Poll for events with 100ms timeout */
-      if (poll(fds, 2, 100) < 0) {
+      /* Poll for events with 100ms timeout, less if a pre-render is due */
+      int timeout = 100;
+      int due = prerender_timeout();
+      if (due >= 0 && due < timeout)
+        timeout = due;
+
+      if (poll(fds, 3, timeout) < 0) {
         if (errno == EINTR) {
           wl_display_cancel_read(display);
           continue;
@@ -496,6 +771,18 @@ static int run_daemon(void) {
         close(client);
       }
     }
+
+    /* Commit the frame the render thread just finished */
+    if (fds[2].revents & POLLIN)
+      render_handle_completion();
+
+    /* Hover from all motion read above, then at most one frame for
+     * everything handled */
+    input_dispatch_pointer();
+    render_dispatch();
+
+    if (prerender_timeout() == 0)
+      prerender_panel();
   }
 
   /* 7. Cleanup */
@@ -503,6 +790,8 @@ static int run_daemon(void) {
 
   cleanup_server(socket_fd);
   input_cleanup();
+  render_cleanup();
+  thumbnails_cleanup();
   icons_cleanup();
   app_state_free(&app_state);
   free_config(config);
@@ -512,12 +801,23 @@ static int run_daemon(void) {
     backend = NULL;
   }
 
+  highlight_detach();
+  destroy_scale_objects();
   if (layer_surface)
     zwlr_layer_surface_v1_destroy(layer_surface);
   if (surface)
     wl_surface_destroy(surface);
+  if (viewporter)
+    wp_viewporter_destroy(viewporter);
+  if (subcompositor)
+    wl_subcompositor_destroy(subcompositor);
+  if (fractional_scale_manager)
+    wp_fractional_scale_manager_v1_destroy(fractional_scale_manager);
+  outputs_cleanup();
   if (keyboard)
     wl_keyboard_destroy(keyboard);
+  if (pointer)
+    wl_pointer_destroy(pointer);
   if (seat)
     wl_seat_destroy(seat);
   if (display)
@@ -530,10 +830,22 @@ static int run_daemon(void) {
 int main(int argc, char **argv) {
   if (argc > 1 && strcmp(argv[1], "--daemon") == 0) {
     return run_daemon();
+  } else if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+    return bench_run(argc > 2 ? argv[2] : "all");
+  } else if (argc > 1 && strcmp(argv[1], "--capture-thumbnails") == 0) {
+    return thumbnails_capture_all(argc > 2 ? argv[2] : ".");
+  } else if (argc > 1 && (strcmp(argv[1], "--render-png") == 0 ||
+                          strcmp(argv[1], "--windows") == 0 ||
+                          strcmp(argv[1], "--theme") == 0)) {
+    return headless_run(argc - 1, argv + 1);
   } else if (argc > 1) {
     return run_client(argv[1]);
   }
 
-  fprintf(stderr, "Usage: %s <command> | --daemon\n", argv[0]);
+  fprintf(stderr,
+          "Usage: %s <command> | --daemon | --bench [name] |\n"
+          "       --render-png out.png --windows fixture.json [options] |\n"
+          "       --capture-thumbnails [dir]\n",
+          argv[0]);
   return 1;
 }
\ No newline at end of file
@@ -0,0 +1,275 @@
+/* src/outputs.c - Output Tracking
+ *
+ * Every monitor is bound, so the panel can be opened on a chosen one and
+ * sized and scaled for it before the compositor says where it landed.
+ * wl_output gives the mode and an integer scale; xdg_output, when the
+ * compositor has it, gives the logical size the layout really gets, which
+ * differs from mode / scale on fractionally scaled outputs.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "outputs.h"
+#include "xdg-output-unstable-v1-client-protocol.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Outputs] " fmt "\n", ##__VA_ARGS__)
+
+output_callback_t on_output_changed = NULL;
+output_callback_t on_output_removed = NULL;
+
+static Output outputs[OUTPUTS_MAX];
+static struct zxdg_output_manager_v1 *xdg_output_manager = NULL;
+
+static void notify_changed(Output *out) {
+  int slot = (int)(out - outputs);
+  int w, h;
+  outputs_logical_size(out, &w, &h);
+  LOG("%s is %dx%d logical pixels", out->name[0] ? out->name : "Output", w,
+      h);
+  if (on_output_changed)
+    on_output_changed(slot);
+}
+
+static void output_geometry(void *data, struct wl_output *wl_output, int32_t x,
+                            int32_t y, int32_t physical_width,
+                            int32_t physical_height, int32_t subpixel,
+                            const char *make, const char *model,
+                            int32_t transform) {
+  Output *out = data;
+  (void)wl_output;
+  (void)x;
+  (void)y;
+  (void)physical_width;
+  (void)physical_height;
+  (void)subpixel;
+  (void)make;
+  (void)model;
+  out->transform = transform;
+}
+
+static void output_mode(void *data, struct wl_output *wl_output,
+                        uint32_t flags, int32_t width, int32_t height,
+                        int32_t refresh) {
+  Output *out = data;
+  (void)wl_output;
+  (void)refresh;
+  if (flags & WL_OUTPUT_MODE_CURRENT) {
+    out->mode_w = width;
+    out->mode_h = height;
+  }
+}
+
+/* Mode and scale are complete (and xdg_output's size, from version 3) */
+static void output_done(void *data, struct wl_output *wl_output) {
+  (void)wl_output;
+  notify_changed(data);
+}
+
+static void output_scale(void *data, struct wl_output *wl_output,
+                         int32_t factor) {
+  Output *out = data;
+  (void)wl_output;
+  out->scale = factor > 0 ? factor : 1;
+}
+
+static void output_name(void *data, struct wl_output *wl_output,
+                        const char *name) {
+  Output *out = data;
+  (void)wl_output;
+  snprintf(out->name, sizeof(out->name), "%s", name);
+}
+
+static void output_description(void *data, struct wl_output *wl_output,
+                               const char *description) {
+  (void)data;
+  (void)wl_output;
+  (void)description;
+}
+
+static const struct wl_output_listener output_listener = {
+    .geometry = output_geometry,
+    .mode = output_mode,
+    .done = output_done,
+    .scale = output_scale,
+    .name = output_name,
+    .description = output_description,
+};
+
+static void xdg_output_position(void *data, struct zxdg_output_v1 *xdg_output,
+                                int32_t x, int32_t y) {
+  (void)data;
+  (void)xdg_output;
+  (void)x;
+  (void)y;
+}
+
+static void xdg_output_size(void *data, struct zxdg_output_v1 *xdg_output,
+                            int32_t width, int32_t height) {
+  Output *out = data;
+  (void)xdg_output;
+  out->logical_w = width;
+  out->logical_h = height;
+}
+
+/* Only sent before version 3; later the size comes with wl_output.done */
+static void xdg_output_done(void *data, struct zxdg_output_v1 *xdg_output) {
+  (void)xdg_output;
+  notify_changed(data);
+}
+
+static void xdg_output_name(void *data, struct zxdg_output_v1 *xdg_output,
+                            const char *name) {
+  Output *out = data;
+  (void)xdg_output;
+  snprintf(out->name, sizeof(out->name), "%s", name);
+}
+
+static void xdg_output_description(void *data,
+                                   struct zxdg_output_v1 *xdg_output,
+                                   const char *description) {
+  (void)data;
+  (void)xdg_output;
+  (void)description;
+}
+
+static const struct zxdg_output_v1_listener xdg_output_listener = {
+    .logical_position = xdg_output_position,
+    .logical_size = xdg_output_size,
+    .done = xdg_output_done,
+    .name = xdg_output_name,
+    .description = xdg_output_description,
+};
+
+static void attach_xdg_output(Output *out) {
+  if (!xdg_output_manager || out->xdg_output)
+    return;
+  out->xdg_output =
+      zxdg_output_manager_v1_get_xdg_output(xdg_output_manager, out->wl_output);
+  zxdg_output_v1_add_listener(out->xdg_output, &xdg_output_listener, out);
+}
+
+bool outputs_bind(struct wl_registry *registry, uint32_t name,
+                  const char *interface, uint32_t version) {
+  if (strcmp(interface, zxdg_output_manager_v1_interface.name) == 0) {
+    xdg_output_manager =
+        wl_registry_bind(registry, name, &zxdg_output_manager_v1_interface,
+                         version < 3 ? version : 3);
+    /* Outputs announced before the manager */
+    for (int i = 0; i < OUTPUTS_MAX; i++) {
+      if (outputs[i].wl_output)
+        attach_xdg_output(&outputs[i]);
+    }
+    return true;
+  }
+
+  if (strcmp(interface, wl_output_interface.name) != 0)
+    return false;
+
+  Output *out = NULL;
+  for (int i = 0; i < OUTPUTS_MAX && !out; i++) {
+    if (!outputs[i].wl_output)
+      out = &outputs[i];
+  }
+  if (!out) {
+    LOG("More than %d outputs, ignoring output %u", OUTPUTS_MAX, name);
+    return true;
+  }
+
+  memset(out, 0, sizeof(Output));
+  out->global = name;
+  out->scale = 1;
+  out->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+  /* Version 4 adds the connector name */
+  out->wl_output = wl_registry_bind(registry, name, &wl_output_interface,
+                                    version < 4 ? version : 4);
+  wl_output_add_listener(out->wl_output, &output_listener, out);
+  attach_xdg_output(out);
+  return true;
+}
+
+static void destroy_output(Output *out) {
+  if (out->xdg_output)
+    zxdg_output_v1_destroy(out->xdg_output);
+  /* From version 3 the compositor frees its side only on release */
+  if (wl_output_get_version(out->wl_output) >= WL_OUTPUT_RELEASE_SINCE_VERSION)
+    wl_output_release(out->wl_output);
+  else
+    wl_output_destroy(out->wl_output);
+  memset(out, 0, sizeof(Output));
+}
+
+void outputs_remove(uint32_t name) {
+  for (int i = 0; i < OUTPUTS_MAX; i++) {
+    Output *out = &outputs[i];
+    if (!out->wl_output || out->global != name)
+      continue;
+
+    LOG("%s removed", out->name[0] ? out->name : "Output");
+    if (on_output_removed)
+      on_output_removed(i);
+    destroy_output(out);
+    return;
+  }
+}
+
+Output *outputs_get(int slot) {
+  if (slot < 0 || slot >= OUTPUTS_MAX || !outputs[slot].wl_output)
+    return NULL;
+  return &outputs[slot];
+}
+
+int outputs_find(const struct wl_output *wl_output) {
+  for (int i = 0; i < OUTPUTS_MAX && wl_output; i++) {
+    if (outputs[i].wl_output == wl_output)
+      return i;
+  }
+  return -1;
+}
+
+int outputs_find_name(const char *name) {
+  for (int i = 0; i < OUTPUTS_MAX && name && name[0]; i++) {
+    if (outputs[i].wl_output && strcmp(outputs[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+void outputs_logical_size(const Output *out, int *width, int *height) {
+  if (out->logical_w > 0 && out->logical_h > 0) {
+    *width = out->logical_w;
+    *height = out->logical_h;
+    return;
+  }
+
+  *width = out->mode_w / out->scale;
+  *height = out->mode_h / out->scale;
+  if (out->transform & 1) { /* Rotated by 90 or 270 degrees */
+    int t = *width;
+    *width = *height;
+    *height = t;
+  }
+}
+
+uint32_t outputs_scale120(const Output *out) {
+  if (out->scale120)
+    return out->scale120;
+
+  /* The mode spread over the logical size is the compositor's scale */
+  int mode_w = out->transform & 1 ? out->mode_h : out->mode_w;
+  if (out->logical_w > 0 && mode_w > 0)
+    return (uint32_t)lround(120.0 * mode_w / out->logical_w);
+  return (uint32_t)out->scale * 120;
+}
+
+void outputs_cleanup(void) {
+  for (int i = 0; i < OUTPUTS_MAX; i++) {
+    if (outputs[i].wl_output)
+      destroy_output(&outputs[i]);
+  }
+  if (xdg_output_manager) {
+    zxdg_output_manager_v1_destroy(xdg_output_manager);
+    xdg_output_manager = NULL;
+  }
+}
@@ -0,0 +1,60 @@
+/* src/outputs.h - Output Tracking */
+#ifndef OUTPUTS_H
+#define OUTPUTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-client.h>
+
+/* Outputs tracked at once; further monitors are ignored */
+#define OUTPUTS_MAX 8
+
+/* One monitor. Its slot in the table stays the same while it exists, so
+ * per-output state elsewhere can be indexed by slot. */
+typedef struct {
+  struct wl_output *wl_output; /* NULL for a free slot */
+  struct zxdg_output_v1 *xdg_output;
+  uint32_t global; /* Registry name */
+  char name[32];   /* Connector, e.g. "DP-1" ("" until known) */
+  int32_t mode_w;  /* Current mode, in device pixels */
+  int32_t mode_h;
+  int32_t scale; /* Integer scale from wl_output */
+  int32_t transform;
+  int32_t logical_w; /* From xdg_output (0 = unknown) */
+  int32_t logical_h;
+  uint32_t scale120; /* Last fractional scale seen on it (0 = unknown) */
+} Output;
+
+/* Callbacks (set by main.c). changed runs once an output's properties
+ * are complete, removed just before the slot is freed. */
+typedef void (*output_callback_t)(int slot);
+extern output_callback_t on_output_changed;
+extern output_callback_t on_output_removed;
+
+/* Bind wl_output and zxdg_output_manager_v1 globals; false if interface
+ * is neither */
+bool outputs_bind(struct wl_registry *registry, uint32_t name,
+                  const char *interface, uint32_t version);
+
+/* A registry global went away; forgets it if it was an output */
+void outputs_remove(uint32_t name);
+
+/* Output in a slot, or NULL */
+Output *outputs_get(int slot);
+
+/* Slot of a wl_output, or of the output with a connector name; -1 if
+ * not tracked */
+int outputs_find(const struct wl_output *wl_output);
+int outputs_find_name(const char *name);
+
+/* Size in logical pixels (0 x 0 until known) */
+void outputs_logical_size(const Output *out, int *width, int *height);
+
+/* Best guess at the fractional scale a surface on the output gets, in
+ * 1/120 units: the last one seen there, else derived from the mode */
+uint32_t outputs_scale120(const Output *out);
+
+/* Destroy every output object */
+void outputs_cleanup(void);
+
+#endif /* OUTPUTS_H */
@@ -1,119 +1,279 @@
 /* src/render.c - Clean Grid UI Rendering */
 #define _POSIX_C_SOURCE 200809L
-#define _USE_MATH_DEFINES
 
 #include "render.h"
+#include "buffer_pool.h"
+#include "card_cache.h"
 #include "config.h"
+#include "engine.h"
+#include "glyph_atlas.h"
+#include "governor.h"
+#include "highlight.h"
+#include "hud.h"
 #include "icons.h"
+#include "layout.h"
+#include "list_view.h"
+#include "outputs.h"
+#include "render_thread.h"
+#include "sprites.h"
+#include "stats.h"
+#include "text.h"
+#include "thumbnails.h"
+#include "tiles.h"
+#include "viewporter-client-protocol.h"
 #include <cairo/cairo.h>
 #include <ctype.h>
-#include <fcntl.h>
 #include <math.h>
 #include <pango/pangocairo.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <strings.h>
-#include <sys/mman.h>
-#include <unistd.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include <time.h>
 
 #define LOG(fmt, ...) fprintf(stderr, "[Render] " fmt "\n", ##__VA_ARGS__)
 
+/* Rasterization runs on a render thread. The main thread snapshots the
+ * state, hands it over with a buffer, and only attaches and commits the
+ * finished frame; the two never share mutable state. Caches, fonts and
+ * everything below marked "render thread" are touched by that thread
+ * alone (or by the main thread when running without one). */
+
+/* --- Main thread --- */
+
+/* The user's config (read-only once set) */
+static Config *base_cfg = NULL;
+
+/* Preferred buffer scale of the surface in 1/120 units */
+static uint32_t output_scale120 = 120;
+
+/* Logical size of the output the panel opens on (0 = unknown) */
+static int output_width = 0;
+static int output_height = 0;
+
+/* Buffers are kept across frames and only reallocated when they grow.
+ * Every output has a pool of its own, so moving the panel to a monitor
+ * with another size or scale finds buffers sized for it instead of
+ * regrowing a shared one; the last pool is for an output not known. */
+#define POOL_COUNT (OUTPUTS_MAX + 1)
+static BufferPool pools[POOL_COUNT];
+static bool pools_ready[POOL_COUNT];
+static int pool_slot = OUTPUTS_MAX; /* Pool of the output rendered for */
+
+/* Identifies the grid drawn into a buffer; bumped when the window list or
+ * layout changes so stale buffers get a full repaint */
+static uint32_t content_serial = 1;
+static int last_count = -1;
+
+/* Frame scheduling: input only marks the panel dirty, and at most one
+ * frame is drawn per wl_surface.frame callback */
+static AppState *pending_state = NULL;
+static bool dirty = false;
+static struct wl_callback *frame_callback = NULL;
+static struct timespec frame_requested_at;
+
+/* Give up on a frame callback the compositor never sends (e.g. occluded) */
+#define FRAME_CALLBACK_TIMEOUT_MS 250
+
+/* The render thread has to drop view state before the next frame */
+static bool reset_view = false;
+
+/* Debug overlay; nothing is measured for it while it is off */
+static bool hud_enabled = false;
+static bool show_pending = false; /* Show requested, not committed yet */
+static struct timespec show_requested;
+static double show_ms = -1;
+static unsigned long icon_hits_at_show = 0;
+static unsigned long icon_misses_at_show = 0;
+
+/* The last committed frame was part of an animation */
+static bool animating = false;
+
+/* Bumped when the surface is hidden, so frames still being rendered for
+ * it are dropped instead of committed */
+static uint32_t generation = 0;
+
+/* Cache invalidations queued for the render thread */
+typedef struct {
+  char *identifier;
+  char *old_title;
+} Invalidation;
+
+static Invalidation *invalidations = NULL;
+static int invalidation_count = 0;
+static int invalidation_capacity = 0;
+
+/* --- Render thread --- */
+
+/* The config with every length converted to buffer pixels for the scale
+ * being rendered. Drawing code reads cfg. */
+static Config scaled_cfg;
 static Config *cfg = NULL;
+static uint32_t scale120 = 120;
+static const Engine *engine = &engine_cairo; /* Composites frames */
+static QualityTier quality = QUALITY_BEST;   /* Of the frame being drawn */
+
+/* Selection cross-fade, sampled from the clock on every frame so late
+ * frames jump straight to the current state */
+typedef struct {
+  bool active;
+  int from; /* Card losing the highlight */
+  int to;   /* Card gaining it */
+  struct timespec start;
+} SelectionAnim;
+
+static SelectionAnim anim;
+static int shown_selected = -1; /* Selection of the last frame drawn */
+
+/* Every card is drawn unselected: the highlight subsurface shows the
+ * selection on top */
+static bool plain_cards = false;
+
+/* A card table and what it was built from. Rebuilt only when one of
+ * these changes; selection changes and scrolling reuse it. */
+typedef struct {
+  Layout layout;
+  bool valid;
+  int count;
+  int columns;
+  int visible_rows;
+  uint32_t width;
+  uint32_t height;
+  uint32_t scale120;
+} LayoutCache;
+
+/* Card table of the grid being drawn */
+static LayoutCache grid_layout;
+
+/* Main thread: card table of the frame on screen, to move the highlight
+ * layer without drawing */
+static LayoutCache shown_layout;
+
+/* First grid row in view when there are more rows than fit */
+static int scroll_row = 0;
+static uint32_t shown_serial = 0; /* Grid of the last frame drawn */
+
+/* Logical pixels to buffer pixels */
+static int px(double v) { return (int)lround(v * scale120 / 120.0); }
+
+/* Font size in points to Pango units at the current scale */
+static int font_size(int points) {
+  return (int)lround((double)points * PANGO_SCALE * scale120 / 120.0);
+}
 
-/* Palette for letter icon fallbacks */
-static const uint32_t icon_colors[] = {
-    0xe78284, /* Red */
-    0xa6d189, /* Green */
-    0x8caaee, /* Blue */
-    0xca9ee6, /* Mauve */
-    0xe5c890, /* Yellow */
-    0x81c8be, /* Teal */
-    0xf4b8e4, /* Pink */
-};
-#define NUM_ICON_COLORS (sizeof(icon_colors) / sizeof(icon_colors[0]))
-
-void render_set_config(Config *config) { cfg = config; }
+/* Thread exit: text state is per thread */
+static void free_text(void) {
+  hud_cleanup();
+  glyph_atlas_cleanup();
+  text_cleanup();
+}
 
-int create_shm_file(off_t size) {
-  char name[] = "/tmp/wswitch-shm-XXXXXX";
-  int fd = mkstemp(name);
-  if (fd < 0)
-    return -1;
-  unlink(name);
-  if (ftruncate(fd, size) < 0) {
-    close(fd);
-    return -1;
+static void update_scaled_config(void) {
+  if (!base_cfg) {
+    cfg = NULL;
+    return;
   }
-  return fd;
+
+  scaled_cfg = *base_cfg;
+  scaled_cfg.card_width = px(base_cfg->card_width);
+  scaled_cfg.card_height = px(base_cfg->card_height);
+  scaled_cfg.card_gap = px(base_cfg->card_gap);
+  scaled_cfg.card_radius = px(base_cfg->card_radius);
+  scaled_cfg.border_width = px(base_cfg->border_width);
+  scaled_cfg.padding = px(base_cfg->padding);
+  scaled_cfg.icon_size = px(base_cfg->icon_size);
+  scaled_cfg.icon_radius = px(base_cfg->icon_radius);
+  scaled_cfg.shadow_size = px(base_cfg->shadow_size);
+  scaled_cfg.list_width = px(base_cfg->list_width);
+  scaled_cfg.list_row_height = px(base_cfg->list_row_height);
+  cfg = &scaled_cfg;
 }
 
-static unsigned int hash_string(const char *str) {
-  unsigned int hash = 5381;
-  int c;
-  while ((c = *str++))
-    hash = ((hash << 5) + hash) + c;
-  return hash;
+/* Set before the render thread starts */
+void render_set_config(Config *config) {
+  base_cfg = config;
+  hud_enabled = config && config->debug_hud;
+  update_scaled_config();
+  /* Cached cards were drawn with the old theme and layout */
+  card_cache_clear();
+  grid_layout.valid = false;
+  shown_layout.valid = false;
+}
+
+void render_set_output_size(int width, int height) {
+  output_width = width > 0 ? width : 0;
+  output_height = height > 0 ? height : 0;
 }
 
-/* Helper to start Pango layout with config font */
-static PangoLayout *create_layout(cairo_t *cr, int size) {
-  PangoLayout *layout = pango_cairo_create_layout(cr);
-  PangoFontDescription *desc = pango_font_description_new();
+static int pool_index(int slot) {
+  return slot >= 0 && slot < OUTPUTS_MAX ? slot : OUTPUTS_MAX;
+}
 
-  const char *family = cfg ? cfg->font_family : "Sans";
-  const char *weight_str = cfg ? cfg->font_weight : "Bold";
-  PangoWeight weight = PANGO_WEIGHT_BOLD;
-  if (strcasecmp(weight_str, "Normal") == 0)
-    weight = PANGO_WEIGHT_NORMAL;
+void render_set_output(int slot) { pool_slot = pool_index(slot); }
 
-  pango_font_description_set_family(desc, family);
-  pango_font_description_set_weight(desc, weight);
-  pango_font_description_set_size(desc, size * PANGO_SCALE);
+void render_set_scale(uint32_t scale) {
+  if (scale == 0)
+    scale = 120;
+  if (scale == output_scale120)
+    return;
 
-  pango_layout_set_font_description(layout, desc);
-  pango_font_description_free(desc);
-  return layout;
+  LOG("Output scale %.3f", scale / 120.0);
+  output_scale120 = scale;
+  /* Cards, sheets and layouts are keyed by scale; only the grid changes */
+  content_serial++;
 }
 
-static void draw_rounded_rect(cairo_t *cr, double x, double y, double w,
-                              double h, double r) {
-  cairo_new_path(cr); /* Critical: reset path */
+static void free_invalidations(Invalidation *list, int count) {
+  for (int i = 0; i < count; i++) {
+    free(list[i].identifier);
+    free(list[i].old_title);
+  }
+  free(list);
+}
 
-  if (r > w / 2)
-    r = w / 2;
-  if (r > h / 2)
-    r = h / 2;
+void render_window_changed(const char *identifier, const char *old_title) {
+  if (!identifier)
+    return;
+
+  if (invalidation_count == invalidation_capacity) {
+    int cap = invalidation_capacity ? invalidation_capacity * 2 : 8;
+    Invalidation *list = realloc(invalidations, cap * sizeof(Invalidation));
+    if (!list)
+      return;
+    invalidations = list;
+    invalidation_capacity = cap;
+  }
+
+  Invalidation *inv = &invalidations[invalidation_count];
+  inv->identifier = strdup(identifier);
+  inv->old_title = old_title ? strdup(old_title) : NULL;
+  if (!inv->identifier) {
+    free(inv->old_title);
+    return;
+  }
+  invalidation_count++;
+}
 
-  cairo_arc(cr, x + r, y + r, r, M_PI, 3 * M_PI / 2);
-  cairo_arc(cr, x + w - r, y + r, r, 3 * M_PI / 2, 0);
-  cairo_arc(cr, x + w - r, y + h - r, r, 0, M_PI / 2);
-  cairo_arc(cr, x + r, y + h - r, r, M_PI / 2, M_PI);
-  cairo_close_path(cr);
+static unsigned int hash_string(const char *str) {
+  unsigned int hash = 5381;
+  int c;
+  while ((c = *str++))
+    hash = ((hash << 5) + hash) + c;
+  return hash;
 }
 
 static void draw_letter_icon(cairo_t *cr, const char *cls, double cx, double cy,
-                             int size, int radius, int letter_size) {
+                             int size, int letter_size) {
   cairo_save(cr);
   cairo_new_path(cr);
 
   /* Background */
-  uint32_t color = icon_colors[hash_string(cls) % NUM_ICON_COLORS];
-  double r, g, b;
-  color_to_rgb(color, &r, &g, &b);
-
-  cairo_set_source_rgb(cr, r, g, b);
-  draw_rounded_rect(cr, cx - size / 2.0, cy - size / 2.0, size, size, radius);
-  cairo_fill(cr);
+  int color = hash_string(cls) % SPRITES_NUM_LETTER_COLORS;
+  sprites_draw(cr, SPRITE_LETTER_FIRST + color, cx - size / 2.0,
+               cy - size / 2.0, size, size, 1.0);
 
   /* Letter */
   char letter[2] = {cls && cls[0] ? toupper(cls[0]) : '?', 0};
-  PangoLayout *layout = create_layout(cr, letter_size);
-  pango_layout_set_text(layout, letter, -1);
+  PangoLayout *layout = text_label_layout(letter, letter_size);
 
   int lw, lh;
   pango_layout_get_pixel_size(layout, &lw, &lh);
@@ -122,7 +282,6 @@ static void draw_letter_icon(cairo_t *cr, const char *cls, double cx, double cy,
   cairo_move_to(cr, cx - lw / 2.0, cy - lh / 2.0);
   pango_cairo_show_layout(cr, layout);
 
-  g_object_unref(layout);
   cairo_restore(cr);
 }
 
@@ -130,6 +289,10 @@ static void draw_icon(cairo_t *cr, const char *cls, double cx, double cy) {
   int size = cfg ? cfg->icon_size : 64;
   int radius = cfg ? cfg->icon_radius : 12;
 
+  /* Keep the icon box on whole pixels so tiles are blitted 1:1 */
+  cx = floor(cx - size / 2.0) + size / 2.0;
+  cy = floor(cy - size / 2.0) + size / 2.0;
+
   cairo_save(cr);
 
   cairo_surface_t *icon = load_app_icon(cls, size);
@@ -145,95 +308,109 @@ static void draw_icon(cairo_t *cr, const char *cls, double cx, double cy) {
     /* Fallback */
     if (icon)
       cairo_surface_destroy(icon);
-    if (!cfg || cfg->show_letter_fallback) {
-      draw_letter_icon(cr, cls, cx, cy, size, radius,
-                       cfg ? cfg->icon_letter_size : 28);
+    if ((!cfg || cfg->show_letter_fallback) &&
+        quality < QUALITY_NO_LETTERS) {
+      draw_letter_icon(cr, cls, cx, cy, size,
+                       font_size(cfg ? cfg->icon_letter_size : 28));
     }
   }
 
   cairo_restore(cr);
 }
 
+/* Window preview centered in the box below the title, on whole pixels.
+ * Thumbnails are made for this box, but one taken before a scale change
+ * can be larger until it is captured again. */
+static void draw_thumbnail(cairo_t *cr, cairo_surface_t *thumb, double x,
+                           double y, int w, int h) {
+  int tw = cairo_image_surface_get_width(thumb);
+  int th = cairo_image_surface_get_height(thumb);
+  double scale = 1.0;
+  if (tw > w || th > h)
+    scale = fmin((double)w / tw, (double)h / th);
+  double dw = tw * scale;
+  double dh = th * scale;
+  double tx = floor(x + (w - dw) / 2.0);
+  double ty = floor(y + (h - dh) / 2.0);
+
+  cairo_save(cr);
+  draw_rounded_rect(cr, tx, ty, dw, dh, cfg ? cfg->icon_radius / 2.0 : 6);
+  cairo_clip(cr);
+  cairo_translate(cr, tx, ty);
+  cairo_scale(cr, scale, scale);
+  cairo_set_source_surface(cr, thumb, 0, 0);
+  cairo_paint(cr);
+  cairo_restore(cr);
+}
+
+/* Whether a card gets the stacked layers of a group (Context Mode) */
+static bool stacked(const WindowInfo *win) {
+  return win->group_count > 1 && quality < QUALITY_NO_STACK;
+}
+
 static void draw_card(cairo_t *cr, WindowInfo *win, double x, double y,
                       bool selected) {
   cairo_save(cr);
 
-  double bg_r, bg_g, bg_b;
-  double sel_r, sel_g, sel_b;
-  double brd_r, brd_g, brd_b;
   double txt_r, txt_g, txt_b;
 
-  if (cfg) {
-    color_to_rgb(cfg->card_bg, &bg_r, &bg_g, &bg_b);
-    color_to_rgb(cfg->card_selected, &sel_r, &sel_g, &sel_b);
-    color_to_rgb(cfg->border_color, &brd_r, &brd_g, &brd_b);
+  if (cfg)
     color_to_rgb(cfg->text_color, &txt_r, &txt_g, &txt_b);
-  }
 
   int w = cfg ? cfg->card_width : 200;
   int h = cfg ? cfg->card_height : 160;
-  int r = cfg ? cfg->card_radius : 12;
-
-  /* Stack effect (Context Mode) */
-  if (win->group_count > 1) {
-    cairo_set_source_rgba(cr, bg_r, bg_g, bg_b, 0.5);
-    draw_rounded_rect(cr, x + 6, y + 6, w, h, r);
-    cairo_fill(cr);
-
-    cairo_set_source_rgba(cr, bg_r, bg_g, bg_b, 0.7);
-    draw_rounded_rect(cr, x + 3, y + 3, w, h, r);
-    cairo_fill(cr);
+  int m = sprites_card_margin();
+
+  /* Stack effect */
+  if (stacked(win)) {
+    sprites_draw(cr, SPRITE_CARD, x + px(6) - m, y + px(6) - m, w + 2 * m,
+                 h + 2 * m, 0.5);
+    sprites_draw(cr, SPRITE_CARD, x + px(3) - m, y + px(3) - m, w + 2 * m,
+                 h + 2 * m, 0.7);
   }
 
-  /* Main Card */
-  if (selected)
-    cairo_set_source_rgb(cr, sel_r, sel_g, sel_b);
-  else
-    cairo_set_source_rgb(cr, bg_r, bg_g, bg_b);
-
-  draw_rounded_rect(cr, x, y, w, h, r);
-  cairo_fill(cr);
-
-  /* Border */
-  if (selected) {
-    cairo_set_source_rgb(cr, brd_r, brd_g, brd_b);
-    cairo_set_line_width(cr, cfg ? cfg->border_width : 2);
-    draw_rounded_rect(cr, x, y, w, h, r);
-    cairo_stroke(cr);
-  }
+  /* Main Card and Border */
+  sprites_draw(cr, selected ? SPRITE_CARD_SELECTED : SPRITE_CARD, x - m,
+               y - m, w + 2 * m, h + 2 * m, 1.0);
 
   /* Title */
-  PangoLayout *title = create_layout(cr, cfg ? cfg->title_size : 12);
-  pango_layout_set_width(title, (w - 20) * PANGO_SCALE);
-  pango_layout_set_ellipsize(title, PANGO_ELLIPSIZE_END);
-  pango_layout_set_alignment(title, PANGO_ALIGN_CENTER);
-  pango_layout_set_text(title, win->title, -1);
-
-  cairo_set_source_rgb(cr, txt_r, txt_g, txt_b);
-  cairo_move_to(cr, x + 10, y + 10);
-  pango_cairo_show_layout(cr, title);
-  g_object_unref(title);
+  int title_w = w - px(20);
+  int title_size = font_size(cfg ? cfg->title_size : 12);
+  if (!cfg || cfg->title_engine != TEXT_ENGINE_ATLAS ||
+      !glyph_atlas_draw_title(cr, win->title, x + px(10), y + px(10), title_w,
+                              title_size, cfg->text_color)) {
+    PangoLayout *title = text_title_layout(win->title, title_w, title_size);
+    cairo_set_source_rgb(cr, txt_r, txt_g, txt_b);
+    cairo_move_to(cr, x + px(10), y + px(10));
+    pango_cairo_show_layout(cr, title);
+  }
 
-  /* Icon */
-  draw_icon(cr, win->class_name, x + w / 2.0,
-            y + 10 + 20 + 10 + (cfg ? cfg->icon_size / 2.0 : 32));
+  /* Preview, or the icon until one has been captured */
+  cairo_surface_t *thumb =
+      cfg && cfg->thumbnails ? thumbnails_get(win->address) : NULL;
+  if (thumb) {
+    draw_thumbnail(cr, thumb, x + px(10), y + px(10 + 20 + 10), w - px(20),
+                   h - px(10 + 20 + 10 + 10));
+    cairo_surface_destroy(thumb);
+  } else {
+    draw_icon(cr, win->class_name, x + w / 2.0,
+              y + px(10 + 20 + 10) + (cfg ? cfg->icon_size / 2.0 : 32));
+  }
 
   /* Badge (Count) */
   if (win->group_count > 1) {
     char count[8];
     snprintf(count, sizeof(count), "%d", win->group_count);
 
-    double bx = x + w - 24;
-    double by = y + h - 24;
+    double bx = x + w - px(24);
+    double by = y + h - px(24);
 
     /* Badge BG (Accent) */
-    cairo_set_source_rgb(cr, brd_r, brd_g, brd_b);
-    cairo_arc(cr, bx, by, 10, 0, 2 * M_PI);
-    cairo_fill(cr);
+    int bs = sprites_badge_size();
+    sprites_draw(cr, SPRITE_BADGE, bx - bs / 2.0, by - bs / 2.0, bs, bs, 1.0);
 
     /* Badge Text (Config Text Color) */
-    PangoLayout *bl = create_layout(cr, 10);
-    pango_layout_set_text(bl, count, -1);
+    PangoLayout *bl = text_label_layout(count, font_size(10));
 
     int bw, bh;
     pango_layout_get_pixel_size(bl, &bw, &bh);
@@ -242,139 +419,1422 @@ static void draw_card(cairo_t *cr, WindowInfo *win, double x, double y,
     cairo_set_source_rgb(cr, txt_r, txt_g, txt_b);
     cairo_move_to(cr, bx - bw / 2.0, by - bh / 2.0);
     pango_cairo_show_layout(cr, bl);
-    g_object_unref(bl);
   }
 
   cairo_restore(cr);
 }
 
+/* Layout sizes from a config, in the config's pixel unit */
+static void layout_metrics(const Config *c, LayoutMetrics *m) {
+  m->card_w = c ? c->card_width : 200;
+  m->card_h = c ? c->card_height : 160;
+  m->gap = c ? c->card_gap : 12;
+  m->padding = c ? c->padding : 32;
+  m->margin = c ? c->shadow_size : 12;
+  m->max_cols = c ? c->max_cols : 5;
+  m->max_rows = c ? c->max_rows : 4;
+  m->avail_w = 0;
+  m->avail_h = 0;
+
+  /* The list view is a one-column grid of rows */
+  if (c && c->mode == MODE_LIST) {
+    m->card_w = c->list_width;
+    m->card_h = c->list_row_height;
+    m->gap = 0;
+    m->max_cols = 1;
+    m->max_rows = c->list_rows;
+  }
+}
+
 void calculate_dimensions(AppState *state, uint32_t *width, uint32_t *height) {
-  int count = (state && state->count > 0) ? state->count : 1;
-  int w = cfg ? cfg->card_width : 200;
-  int h = cfg ? cfg->card_height : 160;
-  int gap = cfg ? cfg->card_gap : 12;
-  int pad = cfg ? cfg->padding : 32;
-  int cols = cfg ? cfg->max_cols : 5;
+  /* Surface size is in logical pixels: use the unscaled config */
+  LayoutMetrics m;
+  layout_metrics(base_cfg, &m);
+  m.avail_w = output_width;
+  m.avail_h = output_height;
+
+  int cols, rows, w, h;
+  layout_fit(&m, state ? state->count : 0, &cols, &rows, &w, &h);
+  if (state) {
+    /* Drawing reuses the shape so it matches the size picked here */
+    state->columns = cols;
+    state->visible_rows = rows;
+  }
 
-  if (count < cols)
-    cols = count;
-  int rows = (count + cols - 1) / cols;
+  /* Room around the panel for its shadow is part of the layout */
+  if (w < 200 + 2 * m.margin)
+    w = 200 + 2 * m.margin;
+  if (h < 150 + 2 * m.margin)
+    h = 150 + 2 * m.margin;
+  *width = w;
+  *height = h;
+}
 
-  *width = (cols * w) + ((cols - 1) * gap) + (pad * 2);
-  *height = (rows * h) + ((rows - 1) * gap) + (pad * 2);
+/* Transparent border around the panel where its shadow falls */
+static int panel_margin(void) { return cfg ? cfg->shadow_size : 12; }
+
+/* Rows drawn by the list view instead of cards */
+static bool list_mode(void) { return cfg && cfg->mode == MODE_LIST; }
+
+/* The grid's card table seen through the current scroll position */
+typedef struct {
+  const Layout *l;
+  int first_row; /* Row drawn at the top of the grid */
+  int first;     /* Visible cards are [first, last) */
+  int last;
+} GridGeometry;
+
+/* The card table for state in a width x height buffer at scale, NULL if
+ * out of memory. Either thread can keep a cache: the sizes come from the
+ * unscaled config, rounded exactly like the scaled one cards draw with. */
+static const Layout *update_layout(LayoutCache *c, const AppState *state,
+                                   uint32_t width, uint32_t height,
+                                   uint32_t scale) {
+  if (c->valid && c->count == state->count &&
+      c->columns == state->columns &&
+      c->visible_rows == state->visible_rows && c->width == width &&
+      c->height == height && c->scale120 == scale)
+    return &c->layout;
+
+  LayoutMetrics m;
+  layout_metrics(base_cfg, &m);
+  m.card_w = (int)lround(m.card_w * scale / 120.0);
+  m.card_h = (int)lround(m.card_h * scale / 120.0);
+  m.gap = (int)lround(m.gap * scale / 120.0);
+  m.padding = (int)lround(m.padding * scale / 120.0);
+  m.margin = (int)lround(m.margin * scale / 120.0);
+  if (layout_build(&c->layout, &m, state->count, state->columns,
+                   state->visible_rows, width, height) < 0) {
+    LOG("Out of memory laying out %d cards", state->count);
+    c->valid = false;
+    return NULL;
+  }
 
-  if (*width < 200)
-    *width = 200;
-  if (*height < 150)
-    *height = 150;
+  c->valid = true;
+  c->count = state->count;
+  c->columns = state->columns;
+  c->visible_rows = state->visible_rows;
+  c->width = width;
+  c->height = height;
+  c->scale120 = scale;
+  return &c->layout;
 }
 
-void render_ui(AppState *state, uint32_t width, uint32_t height) {
-  int stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
-  int size = stride * height;
-  int fd = create_shm_file(size);
-  if (fd < 0)
+/* Scroll just enough to bring the selected row into view */
+static void update_scroll(AppState *state, const Layout *l) {
+  if (!l || state->count == 0) {
+    scroll_row = 0;
     return;
+  }
+
+  int visible = l->visible_rows;
+  int sel_row = state->selected_index / l->columns;
+
+  if (sel_row < scroll_row)
+    scroll_row = sel_row;
+  else if (sel_row >= scroll_row + visible)
+    scroll_row = sel_row - visible + 1;
+
+  if (scroll_row > l->total_rows - visible)
+    scroll_row = l->total_rows - visible;
+  if (scroll_row < 0)
+    scroll_row = 0;
+}
 
-  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-  if (data == MAP_FAILED) {
-    close(fd);
+static void grid_view(const Layout *l, GridGeometry *g) {
+  g->l = l;
+  g->first_row = scroll_row;
+  g->first = g->first_row * l->columns;
+  g->last = (g->first_row + l->visible_rows) * l->columns;
+  if (g->last > l->count)
+    g->last = l->count;
+}
+
+/* Card i's rectangle in the buffer, from the layout table */
+static Rect card_rect(const GridGeometry *g, int i) {
+  return layout_card(g->l, i, g->first_row);
+}
+
+/* r grown by outset on every side and by extra to the bottom right */
+static Rect grow_rect(Rect r, int outset, int extra) {
+  r.x -= outset;
+  r.y -= outset;
+  r.w += 2 * outset + extra;
+  r.h += 2 * outset + extra;
+  return r;
+}
+
+static bool card_visible(const GridGeometry *g, int i) {
+  return i >= g->first && i < g->last;
+}
+
+/* Scroll position indicator in the right padding */
+static Rect scrollbar_track(const GridGeometry *g, uint32_t width) {
+  int pad = cfg ? cfg->padding : 32;
+  Rect r = {0, 0, 0, 0};
+  if (g->l->total_rows <= g->l->visible_rows)
+    return r;
+
+  r.w = px(4);
+  r.x = (int)width - panel_margin() - pad / 2 - r.w / 2;
+  r.y = g->l->grid_y;
+  r.h = g->l->visible_rows * (g->l->card_h + g->l->gap) - g->l->gap;
+  return r;
+}
+
+static void draw_scrollbar(cairo_t *cr, const GridGeometry *g,
+                           uint32_t width) {
+  Rect track = scrollbar_track(g, width);
+  if (track.w == 0)
     return;
+
+  uint32_t color = cfg ? cfg->border_color : 0xffffff;
+  engine->rounded_rect(cr, track.x, track.y, track.w, track.h, track.w / 2.0,
+                       color, 0.15);
+
+  double thumb_h = (double)track.h * g->l->visible_rows / g->l->total_rows;
+  double thumb_y = track.y + (double)track.h * g->first_row / g->l->total_rows;
+  engine->rounded_rect(cr, track.x, thumb_y, track.w, thumb_h, track.w / 2.0,
+                       color, 0.6);
+}
+
+/* Offset of the bottom stack layer (Context Mode) */
+static int card_stack_offset(const WindowInfo *win) {
+  return stacked(win) ? px(6) : 0;
+}
+
+/* Every pixel draw_card() may touch: border stroke and stack layers */
+static Rect card_extent(const GridGeometry *g, WindowInfo *win, int i) {
+  return grow_rect(card_rect(g, i), sprites_card_margin(),
+                   card_stack_offset(win));
+}
+
+/* How far anything drawn for a card reaches outside its rectangle, apart
+ * from the stack layers */
+static int card_outset(void) {
+  int margin = sprites_card_margin();
+  int reach = sprites_shadow_reach(SPRITE_CARD_SHADOW);
+  return reach > margin ? reach : margin;
+}
+
+/* Every pixel a card may touch, including the shadow it casts when
+ * highlighted */
+static Rect card_bounds(const GridGeometry *g, WindowInfo *win, int i) {
+  if (list_mode())
+    return card_rect(g, i); /* Rows never draw outside themselves */
+  return grow_rect(card_rect(g, i), card_outset(), card_stack_offset(win));
+}
+
+static void draw_card_shadow(cairo_t *cr, const GridGeometry *g, int i,
+                             double alpha) {
+  int reach = sprites_shadow_reach(SPRITE_CARD_SHADOW);
+  if (reach > 0) {
+    Rect r = grow_rect(card_rect(g, i), reach, 0);
+    engine->sprite(cr, SPRITE_CARD_SHADOW, r.x, r.y, r.w, r.h, alpha);
   }
+}
 
-  /* CRITICAL FIX 1: Zero buffer */
-  memset(data, 0, size);
+/* Draw a card into a new surface covering its extent */
+static cairo_surface_t *rasterize_card(cairo_antialias_t antialias,
+                                       const Rect *ext, WindowInfo *win,
+                                       bool selected) {
+  cairo_surface_t *card =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, ext->w, ext->h);
+  cairo_t *ccr = cairo_create(card);
+  cairo_set_antialias(ccr, antialias);
+  int margin = sprites_card_margin();
+  draw_card(ccr, win, margin, margin, selected);
+  cairo_destroy(ccr);
+  cairo_surface_flush(card); /* Engines may read it directly */
+  return card;
+}
 
-  cairo_surface_t *surf = cairo_image_surface_create_for_data(
-      data, CAIRO_FORMAT_ARGB32, width, height, stride);
-  cairo_t *cr = cairo_create(surf);
-  cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
+/* Cached card, rasterizing it on a miss (new reference: the cache may
+ * fail to keep one) */
+static cairo_surface_t *get_card(cairo_t *cr, const Rect *ext,
+                                 WindowInfo *win, bool selected) {
+  cairo_surface_t *card = card_cache_lookup(win, selected, scale120);
+  if (card)
+    return cairo_surface_reference(card);
+
+  card = rasterize_card(cairo_get_antialias(cr), ext, win, selected);
+  card_cache_store(win, selected, scale120, card);
+  return card;
+}
 
-  /* CRITICAL FIX 2: Source Clear */
-  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-  cairo_set_source_rgba(cr, 0, 0, 0, 0);
-  cairo_paint(cr);
-  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+/* Renderings a tiled repaint needs for each visible card, indexed from
+ * g->first. Only set while a tiled repaint runs; its workers read cards
+ * from here instead of the cache, which is not thread-safe. */
+typedef struct {
+  cairo_surface_t *card[2]; /* Normal and selected, when used */
+  bool fresh[2];            /* Rasterized for this frame, not cached yet */
+} CardSlot;
+
+static CardSlot *prepared = NULL;
+
+static cairo_surface_t *frame_card(cairo_t *cr, const GridGeometry *g,
+                                   const Rect *ext, WindowInfo *win, int i,
+                                   bool selected) {
+  if (prepared)
+    return cairo_surface_reference(prepared[i - g->first].card[selected]);
+  return get_card(cr, ext, win, selected);
+}
 
-  /* Background */
-  double r, g, b;
-  if (cfg)
-    color_to_rgb(cfg->background, &r, &g, &b);
-  else {
-    r = 0.1;
-    g = 0.1;
-    b = 0.2;
+/* Composite a card from the cache. Between 0 (normal) and 1 (selected)
+ * the selected rendering is blended over the normal one. */
+static void blit_card(cairo_t *cr, const GridGeometry *g, WindowInfo *win,
+                      int i, double highlight) {
+  Rect ext = card_extent(g, win, i);
+
+  cairo_surface_t *card = frame_card(cr, g, &ext, win, i, highlight >= 1.0);
+  engine->image(cr, card, ext.x, ext.y, 1.0);
+  cairo_surface_destroy(card);
+
+  if (highlight > 0.0 && highlight < 1.0) {
+    card = frame_card(cr, g, &ext, win, i, true);
+    engine->image(cr, card, ext.x, ext.y, highlight);
+    cairo_surface_destroy(card);
   }
+}
+
+static bool rects_intersect(const Rect *a, const Rect *b) {
+  return a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h &&
+         b->y < a->y + a->h;
+}
+
+static void draw_background(cairo_t *cr, uint32_t width, uint32_t height) {
+  int m = panel_margin();
+  int reach = sprites_shadow_reach(SPRITE_PANEL_SHADOW);
+  if (reach > 0)
+    engine->sprite(cr, SPRITE_PANEL_SHADOW, m - reach, m - reach,
+                   width - 2 * m + 2 * reach, height - 2 * m + 2 * reach, 1.0);
+  engine->sprite(cr, SPRITE_PANEL, m, m, width - 2 * m, height - 2 * m, 1.0);
+}
 
-  cairo_set_source_rgba(cr, r, g, b, 0.95);
-  int rad = cfg ? cfg->card_radius : 12;
-  draw_rounded_rect(cr, 0, 0, width, height, rad + 4);
-  cairo_fill(cr);
+static void draw_empty_message(cairo_t *cr, uint32_t width, uint32_t height) {
+  double r = 1, g = 1, b = 1;
+  PangoLayout *msg = text_label_layout("No windows", font_size(16));
+  int mw, mh;
+  pango_layout_get_pixel_size(msg, &mw, &mh);
 
-  /* Border */
   if (cfg)
-    color_to_rgb(cfg->border_color, &r, &g, &b);
-  cairo_set_source_rgba(cr, r, g, b, 0.3);
-  cairo_set_line_width(cr, 1);
-  draw_rounded_rect(cr, 0.5, 0.5, width - 1, height - 1, rad + 4);
-  cairo_stroke(cr);
+    color_to_rgb(cfg->text_color, &r, &g, &b);
+  cairo_set_source_rgba(cr, r, g, b, 0.5);
+  cairo_move_to(cr, ((double)width - mw) / 2.0, ((double)height - mh) / 2.0);
+  pango_cairo_show_layout(cr, msg);
+}
+
+static double ms_between(const struct timespec *a, const struct timespec *b) {
+  return (b->tv_sec - a->tv_sec) * 1000.0 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/* Animation progress in [0, 1], eased out */
+static double anim_progress(const struct timespec *now) {
+  int duration = cfg ? cfg->animation_duration : 120;
+  double t = duration > 0 ? ms_between(&anim.start, now) / duration : 1.0;
+  if (t >= 1.0)
+    return 1.0;
+  if (t <= 0.0)
+    return 0.0;
+  double inv = 1.0 - t;
+  return 1.0 - inv * inv * inv;
+}
+
+/* How strongly card i is highlighted in the frame being drawn */
+static double highlight_level(AppState *state, int i, double progress) {
+  if (plain_cards)
+    return 0.0;
+  if (anim.active) {
+    if (i == anim.to)
+      return progress;
+    if (i == anim.from)
+      return 1.0 - progress;
+    return 0.0;
+  }
+  return i == state->selected_index ? 1.0 : 0.0;
+}
+
+/* Visible cards, optionally only those touching clip. Shadows go first so
+ * a highlighted card's shadow never covers its neighbours. */
+static void draw_cards(cairo_t *cr, AppState *state, const GridGeometry *g,
+                       const Rect *clip, double progress) {
+  if (list_mode()) {
+    int size = font_size(cfg->title_size);
+    for (int i = g->first; i < g->last; i++) {
+      Rect row = card_rect(g, i);
+      if (!clip || rects_intersect(&row, clip))
+        list_view_draw_row(cr, cfg, &state->windows[i], &row,
+                           i == state->selected_index, size);
+    }
+    return;
+  }
+
+  for (int i = g->first; i < g->last; i++) {
+    double level = highlight_level(state, i, progress);
+    if (level <= 0.0)
+      continue;
+    Rect bounds = card_bounds(g, &state->windows[i], i);
+    if (!clip || rects_intersect(&bounds, clip))
+      draw_card_shadow(cr, g, i, level);
+  }
+
+  for (int i = g->first; i < g->last; i++) {
+    WindowInfo *win = &state->windows[i];
+    Rect bounds = card_bounds(g, win, i);
+    if (!clip || rects_intersect(&bounds, clip))
+      blit_card(cr, g, win, i, highlight_level(state, i, progress));
+  }
+}
+
+/* Repaint one rectangle of a retained frame: background plus every card
+ * overlapping it, clipped so neighbouring pixels stay untouched */
+static void redraw_rect(cairo_t *cr, AppState *state, const GridGeometry *g,
+                        uint32_t width, uint32_t height, const Rect *rect,
+                        double progress) {
+  cairo_save(cr);
+  cairo_rectangle(cr, rect->x, rect->y, rect->w, rect->h);
+  cairo_clip(cr);
+
+  engine->clear(cr);
+  draw_background(cr, width, height);
+  draw_scrollbar(cr, g, width);
+  draw_cards(cr, state, g, rect, progress);
+
+  cairo_restore(cr);
+}
+
+/* Repaint everything on one thread; g is NULL when there are no cards */
+static void paint_serial(cairo_t *cr, AppState *state, const GridGeometry *g,
+                         uint32_t width, uint32_t height, double progress) {
+  /* Buffers are reused, so wipe the previous frame */
+  engine->clear(cr);
+
+  draw_background(cr, width, height);
 
   /* Content */
-  if (!state || state->count == 0) {
-    PangoLayout *msg = create_layout(cr, 16);
-    pango_layout_set_text(msg, "No windows", -1);
-    int mw, mh;
-    pango_layout_get_pixel_size(msg, &mw, &mh);
-
-    if (cfg)
-      color_to_rgb(cfg->text_color, &r, &g, &b);
-    cairo_set_source_rgba(cr, r, g, b, 0.5);
-    cairo_move_to(cr, (width - mw) / 2.0, (height - mh) / 2.0);
-    pango_cairo_show_layout(cr, msg);
-    g_object_unref(msg);
+  if (!g) {
+    draw_empty_message(cr, width, height);
   } else {
-    int cw = cfg ? cfg->card_width : 200;
-    int ch = cfg ? cfg->card_height : 160;
-    int gap = cfg ? cfg->card_gap : 12;
-    int pad = cfg ? cfg->padding : 32;
-    int max_cols = cfg ? cfg->max_cols : 5;
-
-    int cols = (state->count < max_cols) ? state->count : max_cols;
-    int rows = (state->count + max_cols - 1) / max_cols;
-
-    int grid_w = (cols * cw) + ((cols - 1) * gap);
-    int grid_h = (rows * ch) + ((rows - 1) * gap);
-
-    double start_x = (width - grid_w) / 2.0;
-    double start_y = (height - grid_h) / 2.0;
-    if (start_x < pad)
-      start_x = pad;
-    if (start_y < pad)
-      start_y = pad;
-
-    for (int i = 0; i < state->count; i++) {
-      int r = i / max_cols;
-      int c = i % max_cols;
-      double x = start_x + c * (cw + gap);
-      double y = start_y + r * (ch + gap);
-      draw_card(cr, &state->windows[i], x, y, i == state->selected_index);
+    draw_scrollbar(cr, g, width);
+    draw_cards(cr, state, g, NULL, progress);
+  }
+}
+
+/* A full repaint split into one tile per visible grid row */
+typedef struct {
+  AppState *state;
+  const GridGeometry *g;
+  unsigned char *data;
+  uint32_t width;
+  uint32_t height;
+  int stride;
+  double progress;
+  cairo_antialias_t antialias;
+} TileFrame;
+
+/* cfg->render_threads the tile workers were started for (-1 = none) */
+static int tile_threads = -1;
+
+/* Which renderings of card i get blended at this progress */
+static void card_variants(AppState *state, int i, double progress,
+                          bool need[2]) {
+  double level = highlight_level(state, i, progress);
+  need[0] = level < 1.0;
+  need[1] = level > 0.0;
+}
+
+/* Worker: rasterize the cache misses of one row */
+static void rasterize_row(void *ctx, int row) {
+  TileFrame *f = ctx;
+  const GridGeometry *g = f->g;
+
+  /* Each thread shapes with its own Pango context */
+  text_update(cfg);
+
+  int first = g->first + row * g->l->columns;
+  int last = first + g->l->columns < g->last ? first + g->l->columns : g->last;
+  for (int i = first; i < last; i++) {
+    WindowInfo *win = &f->state->windows[i];
+    CardSlot *slot = &prepared[i - g->first];
+    Rect ext = card_extent(g, win, i);
+    bool need[2];
+    card_variants(f->state, i, f->progress, need);
+    for (int v = 0; v < 2; v++) {
+      if (need[v] && !slot->card[v]) {
+        slot->card[v] = rasterize_card(f->antialias, &ext, win, v);
+        slot->fresh[v] = true;
+      }
     }
   }
+}
 
-  /* Wayland Commit */
-  struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, size);
-  struct wl_buffer *buffer = wl_shm_pool_create_buffer(
-      pool, 0, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+/* Buffer rows [top, bottom) owned by the tile of a grid row: bands split
+ * the gaps between rows, the outer ones extend to the buffer edges */
+static void tile_band(const TileFrame *f, int row, int *top, int *bottom) {
+  const Layout *l = f->g->l;
+  int pitch = l->card_h + l->gap;
+  int y = l->grid_y - l->gap / 2;
 
-  wl_surface_attach(surface, buffer, 0, 0);
-  wl_surface_damage_buffer(surface, 0, 0, width,
-                           height); /* Use damage_buffer for best safety */
-  wl_surface_commit(surface);
+  *top = row == 0 ? 0 : y + row * pitch;
+  *bottom = row == l->visible_rows - 1 ? (int)f->height : y + (row + 1) * pitch;
+}
+
+/* Worker: composite one band through its own cairo context, which only
+ * sees the band's rows of the shared buffer */
+static void composite_row(void *ctx, int row) {
+  TileFrame *f = ctx;
+  int top, bottom;
+  tile_band(f, row, &top, &bottom);
+  if (bottom <= top)
+    return;
+
+  cairo_surface_t *surf = cairo_image_surface_create_for_data(
+      f->data + (size_t)top * f->stride, CAIRO_FORMAT_ARGB32, f->width,
+      bottom - top, f->stride);
+  cairo_t *cr = cairo_create(surf);
+  cairo_set_antialias(cr, f->antialias);
+  cairo_translate(cr, 0, -top);
+
+  Rect band = {0, top, (int)f->width, bottom - top};
+  redraw_rect(cr, f->state, f->g, f->width, f->height, &band, f->progress);
 
   cairo_destroy(cr);
+  cairo_surface_flush(surf);
   cairo_surface_destroy(surf);
-  wl_buffer_destroy(buffer);
-  wl_shm_pool_destroy(pool);
-  close(fd);
-  munmap(data, size);
+}
+
+/* Repaint everything with the grid rows spread over the tile workers.
+ * Returns false (nothing drawn) if the frame is not worth splitting. */
+static bool paint_tiled(AppState *state, const GridGeometry *g,
+                        unsigned char *data, uint32_t width, uint32_t height,
+                        int stride, double progress) {
+  int want = cfg ? cfg->render_threads : 0;
+  if (want != tile_threads) {
+    tiles_start(want, free_text);
+    tile_threads = want;
+  }
+  if (!g || list_mode() || g->l->visible_rows < 2 || tiles_threads() < 2)
+    return false;
+
+  int n = g->last - g->first;
+  CardSlot *slots = calloc(n, sizeof(CardSlot));
+  if (!slots)
+    return false;
+
+  TileFrame f = {
+      .state = state,
+      .g = g,
+      .data = data,
+      .width = width,
+      .height = height,
+      .stride = stride,
+      .progress = progress,
+      .antialias = governor_antialias(quality),
+  };
+
+  /* Cache hits are collected up front, misses rasterized in parallel and
+   * stored afterwards: the cache itself is only touched from here */
+  for (int i = g->first; i < g->last; i++) {
+    bool need[2];
+    card_variants(state, i, progress, need);
+    for (int v = 0; v < 2; v++) {
+      cairo_surface_t *card =
+          need[v] ? card_cache_lookup(&state->windows[i], v, scale120) : NULL;
+      if (card)
+        slots[i - g->first].card[v] = cairo_surface_reference(card);
+    }
+  }
+
+  prepared = slots;
+  tiles_run(g->l->visible_rows, rasterize_row, &f);
+
+  for (int i = g->first; i < g->last; i++) {
+    for (int v = 0; v < 2; v++) {
+      if (slots[i - g->first].fresh[v])
+        card_cache_store(&state->windows[i], v, scale120,
+                         slots[i - g->first].card[v]);
+    }
+  }
+
+  tiles_run(g->l->visible_rows, composite_row, &f);
+  prepared = NULL;
+
+  for (int i = 0; i < n; i++) {
+    for (int v = 0; v < 2; v++) {
+      if (slots[i].card[v])
+        cairo_surface_destroy(slots[i].card[v]);
+    }
+  }
+  free(slots);
+  return true;
+}
+
+/* Start, retarget or finish the selection animation for this frame.
+ * Returns the progress to draw with. */
+static double update_animation(AppState *state, bool same_grid,
+                               const struct timespec *now, bool *started) {
+  int count = state ? state->count : 0;
+  int duration = cfg ? cfg->animation_duration : 120;
+  if (list_mode() || plain_cards)
+    duration = 0; /* Rows and the highlight layer switch instantly */
+
+  if (!same_grid || count == 0 || duration <= 0) {
+    anim.active = false;
+  } else if (state->selected_index != shown_selected && shown_selected >= 0 &&
+             shown_selected < count) {
+    /* A card that was still fading out snaps off; bursts never queue */
+    *started = !anim.active;
+    anim.active = true;
+    anim.from = shown_selected;
+    anim.to = state->selected_index;
+    anim.start = *now;
+  }
+
+  if (!anim.active)
+    return 1.0;
+
+  double progress = anim_progress(now);
+  if (progress >= 1.0)
+    anim.active = false;
+  return progress;
+}
+
+/* Add a card's extent to the damage list unless it is already there */
+static void add_card_damage(Rect *damage, int *n, int *cards,
+                            const GridGeometry *g, AppState *state, int i) {
+  if (i < 0 || i >= state->count || !card_visible(g, i))
+    return;
+  for (int k = 0; k < *n; k++) {
+    if (cards[k] == i)
+      return;
+  }
+  cards[*n] = i;
+  damage[(*n)++] = card_bounds(g, &state->windows[i], i);
+}
+
+/* Move the retained rows of a buffer by the rows scrolled since it was
+ * drawn. Returns the strip that scrolled into view and needs drawing. */
+static Rect scroll_retained(ShmBuffer *buf, const GridGeometry *g,
+                            int scrolled) {
+  const Layout *l = g->l;
+  int pitch = l->card_h + l->gap;
+  int top = l->grid_y - card_outset();
+  int bottom = l->grid_y + l->visible_rows * pitch + px(6) + card_outset();
+  if (top < 0)
+    top = 0;
+  if (bottom > (int)buf->height)
+    bottom = buf->height;
+
+  int shift = abs(scrolled) * pitch;
+  int rows = bottom - top - shift;
+  Rect exposed = {0, top, buf->width, bottom - top};
+  if (rows <= 0)
+    return exposed;
+
+  uint8_t *data = buf->data;
+  size_t stride = buf->stride;
+  if (scrolled > 0) {
+    /* Content moves up; new rows appear at the bottom */
+    memmove(data + top * stride, data + (top + shift) * stride,
+            rows * stride);
+    exposed.y = top + rows;
+  } else {
+    memmove(data + (top + shift) * stride, data + top * stride,
+            rows * stride);
+  }
+  exposed.h = shift;
+  return exposed;
+}
+
+/* Render thread: rebuild chrome and fonts if the theme changed */
+static void update_resources(void) {
+  /* Cheap when the theme is unchanged; cards embed the old chrome */
+  bool chrome_changed = sprites_update(cfg, scale120);
+  bool font_changed = text_update(cfg);
+  if (chrome_changed || font_changed)
+    card_cache_clear();
+  engine = engine_get(cfg ? cfg->render_engine : RENDER_ENGINE_CAIRO);
+}
+
+/* The last frame committed. Damage is relative to it, and with several
+ * buffers in the pool it is usually not the buffer being patched. */
+typedef struct {
+  bool drawn; /* A frame is on screen */
+  bool valid; /* ...drawn with plain cards, under the highlight layer */
+  const ShmBuffer *buf;
+  uint32_t content_serial;
+  uint32_t width; /* Buffer size */
+  uint32_t height;
+  uint32_t scale120;
+  int first_row;
+  int selected; /* Highlighted card in buf, and the one fading out */
+  int fade_from;
+  int quality;
+} ShownGrid;
+
+/* A frame to rasterize: owned by the render thread from submit until it
+ * comes back completed */
+typedef struct {
+  /* Input */
+  AppState state; /* Private copy of the windows and selection */
+  ShmBuffer *buf;
+  int pool_slot; /* Pool buf came from */
+  uint32_t scale120;
+  uint32_t content_serial;
+  uint32_t generation;
+  bool reset_view;
+  bool speculative; /* Pre-render while hidden: kept, not committed */
+  bool plain;       /* Leave the selection to the highlight layer */
+  bool hud;         /* Draw the debug overlay with hud_stats */
+  HudStats hud_stats;
+  ShownGrid shown; /* On screen when the job was started */
+  Invalidation *invalidations;
+  int invalidation_count;
+
+  /* Output */
+  Rect damage[7]; /* Up to six cards and the overlay */
+  int n_damage;
+  bool full_damage;
+  bool animating;
+  bool anim_started;
+  int first_row; /* Grid row at the top of the view */
+  double render_ms;
+  QualityTier quality; /* Tier it was drawn at */
+} RenderJob;
+
+/* Two slots, so one can be torn down while the other is rendered */
+static RenderJob jobs[2];
+static int next_job = 0;
+static RenderJob *in_flight = NULL;
+static bool threaded = false;
+
+/* Frame pre-rendered while hidden for the panel the next show is
+ * expected to open with */
+static struct {
+  ShmBuffer *buf; /* Reserved (busy) until attached or dropped */
+  AppState state; /* What it shows */
+  uint32_t scale120;
+  uint32_t content_serial;
+  bool plain;
+  int first_row;
+  int pool_slot; /* Output it was drawn for */
+} ready;
+
+/* The grid on screen, so a selection change inside its rows only has to
+ * move the highlight layer, and the pointer can be matched to its cards */
+static ShownGrid shown_grid;
+
+/* Whether the frames being drawn leave the selection to the highlight */
+static bool layered = false;
+
+/* Render thread: draw a snapshot into its buffer */
+static void render_job(void *data) {
+  RenderJob *job = data;
+  ShmBuffer *buf = job->buf;
+  AppState *state = &job->state;
+  uint32_t width = buf->width;
+  uint32_t height = buf->height;
+
+  struct timespec frame_start;
+  clock_gettime(CLOCK_MONOTONIC, &frame_start);
+
+  /* Catch up with what the main thread changed since the last frame */
+  if (job->scale120 != scale120) {
+    scale120 = job->scale120;
+    update_scaled_config();
+  }
+  for (int i = 0; i < job->invalidation_count; i++) {
+    card_cache_invalidate(job->invalidations[i].identifier);
+    text_invalidate(job->invalidations[i].old_title);
+  }
+  if (job->reset_view) {
+    anim.active = false;
+    shown_selected = -1;
+    scroll_row = 0;
+  }
+  plain_cards = job->plain;
+
+  update_resources();
+  /* Cached cards were drawn at the old tier */
+  if (governor_tier() != quality) {
+    quality = governor_tier();
+    card_cache_clear();
+  }
+  job->quality = quality;
+
+  int count = state->count;
+  uint32_t serial = job->content_serial;
+  double progress = update_animation(state, shown_serial == serial,
+                                     &frame_start, &job->anim_started);
+  shown_serial = serial;
+
+  /* Same table as the last frame unless the list, size or scale moved */
+  const Layout *l =
+      count > 0 ? update_layout(&grid_layout, state, width, height, scale120)
+                : NULL;
+  update_scroll(state, l);
+
+  cairo_surface_t *surf = cairo_image_surface_create_for_data(
+      buf->data, CAIRO_FORMAT_ARGB32, width, height, buf->stride);
+  cairo_t *cr = cairo_create(surf);
+  cairo_set_antialias(cr, governor_antialias(quality));
+
+  Rect *damage = job->damage;
+  int damage_cards[6];
+  int n_damage = 0;
+  bool full_damage = true;
+
+  GridGeometry g;
+  if (l)
+    grid_view(l, &g);
+
+  /* Rows scrolled since this buffer was drawn; far jumps repaint */
+  bool retained = l && buf->content_serial == serial &&
+                  buf->content_quality == (int)quality;
+  int scrolled = retained ? g.first_row - buf->content_first_row : 0;
+  if (retained && abs(scrolled) >= g.l->visible_rows)
+    retained = false;
+  /* Scrolling would drag a copy of the overlay along with the rows */
+  if (retained && scrolled != 0 && job->hud)
+    retained = false;
+
+  if (retained) {
+    /* Same grid as what this buffer holds: only cards that are or were
+     * highlighted in either frame can differ, plus rows scrolled in */
+    if (scrolled != 0) {
+      Rect exposed = scroll_retained(buf, &g, scrolled);
+      Rect track = scrollbar_track(&g, width);
+      redraw_rect(cr, state, &g, width, height, &exposed, progress);
+      redraw_rect(cr, state, &g, width, height, &track, progress);
+    } else {
+      full_damage = false;
+    }
+
+    /* Against another buffer on screen, its highlighted cards change too;
+     * if it shows another grid, everything may */
+    const ShownGrid *shown = &job->shown;
+    bool other = shown->drawn && shown->buf != buf;
+    if (!shown->drawn ||
+        (other &&
+         (shown->valid != plain_cards || shown->content_serial != serial ||
+          shown->width != width || shown->height != height ||
+          shown->scale120 != scale120 || shown->first_row != g.first_row ||
+          shown->quality != (int)quality)))
+      full_damage = true;
+
+    if (!plain_cards) {
+      if (other) {
+        add_card_damage(damage, &n_damage, damage_cards, &g, state,
+                        shown->selected);
+        add_card_damage(damage, &n_damage, damage_cards, &g, state,
+                        shown->fade_from);
+      }
+      add_card_damage(damage, &n_damage, damage_cards, &g, state,
+                      buf->content_selected);
+      add_card_damage(damage, &n_damage, damage_cards, &g, state,
+                      buf->content_fade_from);
+      if (anim.active)
+        add_card_damage(damage, &n_damage, damage_cards, &g, state,
+                        anim.from);
+      add_card_damage(damage, &n_damage, damage_cards, &g, state,
+                      state->selected_index);
+    }
+
+    for (int i = 0; i < n_damage; i++)
+      redraw_rect(cr, state, &g, width, height, &damage[i], progress);
+  } else if (job->speculative ||
+             !paint_tiled(state, l ? &g : NULL, buf->data, width, height,
+                          buf->stride, progress)) {
+    /* Pre-renders stay on one thread so they never compete for cores */
+    paint_serial(cr, state, l ? &g : NULL, width, height, progress);
+  }
+
+  if (job->hud) {
+    Rect r = hud_rect(width, height, panel_margin(), scale120);
+    hud_draw(cr, &r, &job->hud_stats, scale120);
+    if (!full_damage)
+      damage[n_damage++] = r;
+  }
+
+  cairo_destroy(cr);
+  cairo_surface_flush(surf);
+  cairo_surface_destroy(surf);
+
+  buf->content_serial = serial;
+  buf->content_selected = state->selected_index;
+  buf->content_fade_from = anim.active ? anim.from : -1;
+  buf->content_first_row = scroll_row;
+  buf->content_quality = quality;
+  shown_selected = buf->content_selected;
+
+  job->n_damage = n_damage;
+  job->full_damage = full_damage;
+  job->animating = anim.active;
+  job->first_row = scroll_row;
+
+  struct timespec frame_end;
+  clock_gettime(CLOCK_MONOTONIC, &frame_end);
+  job->render_ms = ms_between(&frame_start, &frame_end);
+
+  /* Only full repaints are comparable; pre-renders have no deadline */
+  if (!retained && !job->speculative)
+    governor_update(cfg ? cfg->frame_budget_ms : 0, job->render_ms);
+}
+
+double render_to_memory(AppState *state, unsigned char *data, uint32_t width,
+                        uint32_t height, int stride) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (output_scale120 != scale120) {
+    scale120 = output_scale120;
+    update_scaled_config();
+  }
+  update_resources();
+
+  anim.active = false;
+  plain_cards = false;
+  const Layout *l = state->count > 0 ? update_layout(&grid_layout, state,
+                                                     width, height, scale120)
+                                     : NULL;
+  update_scroll(state, l);
+
+  GridGeometry g;
+  if (l)
+    grid_view(l, &g);
+  const GridGeometry *grid = l ? &g : NULL;
+
+  if (!paint_tiled(state, grid, data, width, height, stride, 1.0)) {
+    cairo_surface_t *surf = cairo_image_surface_create_for_data(
+        data, CAIRO_FORMAT_ARGB32, width, height, stride);
+    cairo_t *cr = cairo_create(surf);
+    cairo_set_antialias(cr, governor_antialias(quality));
+    paint_serial(cr, state, grid, width, height, 1.0);
+    cairo_destroy(cr);
+    cairo_surface_flush(surf);
+    cairo_surface_destroy(surf);
+  }
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return ms_between(&start, &end);
+}
+
+/* --- Main thread: scheduling and commits --- */
+
+void render_invalidate(void) { content_serial++; }
+
+static long ms_since(const struct timespec *t) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - t->tv_sec) * 1000 + (now.tv_nsec - t->tv_nsec) / 1000000;
+}
+
+static void frame_done(void *data, struct wl_callback *callback,
+                       uint32_t time) {
+  (void)data;
+  wl_callback_destroy(callback);
+  frame_callback = NULL;
+  if (animating)
+    stats_frame_presented(time);
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = frame_done,
+};
+
+void render_init(void) {
+  threaded = render_thread_start(render_job, free_text);
+  if (!threaded)
+    LOG("Rendering on the main thread");
+}
+
+int render_get_fd(void) { return render_thread_get_fd(); }
+
+static void release_job(RenderJob *job) {
+  app_state_free(&job->state);
+  free_invalidations(job->invalidations, job->invalidation_count);
+  memset(job, 0, sizeof(RenderJob));
+}
+
+static void request_frame_callback(void) {
+  if (!frame_callback) {
+    frame_callback = wl_surface_frame(surface);
+    wl_callback_add_listener(frame_callback, &frame_listener, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &frame_requested_at);
+  }
+}
+
+/* Attach a buffer to the surface; damage NULL means the whole buffer */
+static void commit_buffer(ShmBuffer *buf, const AppState *state,
+                          const Rect *damage, int n_damage) {
+  if (viewport)
+    wp_viewport_set_destination(viewport, state->width, state->height);
+  wl_surface_attach(surface, buf->wl_buffer, 0, 0);
+  if (!damage) {
+    /* Use damage_buffer for best safety */
+    wl_surface_damage_buffer(surface, 0, 0, buf->width, buf->height);
+  } else {
+    for (int i = 0; i < n_damage; i++)
+      wl_surface_damage_buffer(surface, damage[i].x, damage[i].y, damage[i].w,
+                               damage[i].h);
+  }
+  request_frame_callback();
+  wl_surface_commit(surface);
+
+  if (show_pending) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    show_ms = ms_between(&show_requested, &now);
+    show_pending = false;
+  }
+}
+
+/* Draw the selection on a subsurface when the compositor can, unless the
+ * list view (which redraws rows anyway) is in use */
+static bool use_highlight_layer(void) {
+  return subcompositor && (!base_cfg || (base_cfg->selection_layer &&
+                                         base_cfg->mode != MODE_LIST));
+}
+
+/* Switching between the two ways of showing the selection changes what
+ * every card looks like */
+static void update_layered(void) {
+  bool want = use_highlight_layer();
+  if (want != layered) {
+    layered = want;
+    content_serial++;
+  }
+}
+
+/* Put the highlight over the selection of a grid drawn with plain cards
+ * at scale, or hide it when the selection is scrolled out of view */
+static void place_highlight(const AppState *state, uint32_t width,
+                            uint32_t height, uint32_t scale, int first_row) {
+  const Layout *l =
+      state->count > 0
+          ? update_layout(&shown_layout, state, width, height, scale)
+          : NULL;
+  int sel = state->selected_index;
+  if (!l || sel < first_row * l->columns ||
+      sel >= (first_row + l->visible_rows) * l->columns || sel >= l->count) {
+    highlight_hide();
+    return;
+  }
+
+  Rect r = layout_card(l, sel, first_row);
+  highlight_show(base_cfg, r.x, r.y, r.w, r.h, scale);
+}
+
+/* Note the grid about to be committed, and set the highlight layer up
+ * for it; both take effect with that commit */
+static void show_grid(const AppState *state, const ShmBuffer *buf,
+                      uint32_t scale, uint32_t serial, int first_row,
+                      bool plain) {
+  shown_grid.drawn = true;
+  shown_grid.valid = plain;
+  shown_grid.buf = buf;
+  shown_grid.content_serial = serial;
+  shown_grid.width = buf->width;
+  shown_grid.height = buf->height;
+  shown_grid.scale120 = scale;
+  shown_grid.first_row = first_row;
+  shown_grid.selected = buf->content_selected;
+  shown_grid.fade_from = buf->content_fade_from;
+  shown_grid.quality = buf->content_quality;
+
+  if (plain)
+    place_highlight(state, buf->width, buf->height, scale, first_row);
+  else
+    highlight_hide();
+}
+
+/* The selection moved within the rows on screen: move the highlight and
+ * commit the panel, without drawing anything */
+static bool move_highlight(uint32_t width, uint32_t height) {
+  if (!layered || !shown_grid.valid || pending_state->count == 0 ||
+      shown_grid.content_serial != content_serial ||
+      shown_grid.width != width || shown_grid.height != height ||
+      shown_grid.scale120 != output_scale120)
+    return false;
+
+  const Layout *l = update_layout(&shown_layout, pending_state, width, height,
+                                  output_scale120);
+  int first = shown_grid.first_row * (l ? l->columns : 0);
+  int sel = pending_state->selected_index;
+  if (!l || sel < first || sel >= first + l->visible_rows * l->columns)
+    return false; /* Needs to scroll: draw a frame */
+
+  place_highlight(pending_state, width, height, output_scale120,
+                  shown_grid.first_row);
+  request_frame_callback();
+  wl_surface_commit(surface);
+  dirty = false;
+  return true;
+}
+
+int render_hit_test(const AppState *state, double x, double y) {
+  if (!shown_grid.drawn || state->count == 0)
+    return -1;
+
+  /* Cards on screen were placed in buffer pixels */
+  const Layout *l = update_layout(&shown_layout, state, shown_grid.width,
+                                  shown_grid.height, shown_grid.scale120);
+  if (!l)
+    return -1;
+  int bx = (int)floor(x * shown_grid.scale120 / 120.0);
+  int by = (int)floor(y * shown_grid.scale120 / 120.0);
+  return layout_hit_test(l, shown_grid.first_row, bx, by);
+}
+
+/* Forget the pre-rendered frame and give its buffer back to the pool */
+static void drop_ready_frame(void) {
+  if (!ready.buf)
+    return;
+  ready.buf->busy = false;
+  app_state_free(&ready.state);
+  memset(&ready, 0, sizeof(ready));
+}
+
+/* Attach a finished frame, unless the surface it was drawn for is gone */
+static void finish_job(RenderJob *job) {
+  in_flight = NULL;
+
+  ShmBuffer *buf = job->buf;
+  if (job->speculative) {
+    /* Keep it, still marked busy, for the next show */
+    drop_ready_frame();
+    ready.buf = buf;
+    ready.state = job->state;
+    ready.scale120 = job->scale120;
+    ready.content_serial = job->content_serial;
+    ready.plain = job->plain;
+    ready.first_row = job->first_row;
+    ready.pool_slot = job->pool_slot;
+    app_state_init(&job->state); /* Moved into ready */
+    release_job(job);
+    return;
+  }
+
+  stats_record_frame(job->render_ms, base_cfg ? base_cfg->frame_budget_ms : 0,
+                     job->quality);
+  if (job->anim_started)
+    stats_reset_presentation();
+
+  if (job->generation != generation || !surface) {
+    buf->busy = false; /* Never attached */
+    release_job(job);
+    return;
+  }
+
+  show_grid(&job->state, buf, job->scale120, job->content_serial,
+            job->first_row, job->plain);
+  commit_buffer(buf, &job->state, job->full_damage ? NULL : job->damage,
+                job->n_damage);
+
+  /* Keep drawing on every frame callback until the animation settles */
+  animating = job->animating;
+  if (animating)
+    dirty = true;
+
+  release_job(job);
+}
+
+void render_handle_completion(void) {
+  RenderJob *job = render_thread_take_completed();
+  if (job)
+    finish_job(job);
+}
+
+void render_schedule(AppState *state) {
+  pending_state = state;
+  dirty = true;
+}
+
+/* Would a frame of a show the same as b? Only what cards draw counts. */
+static bool same_panel(const AppState *a, const AppState *b) {
+  if (a->count != b->count || a->selected_index != b->selected_index ||
+      a->width != b->width || a->height != b->height)
+    return false;
+
+  for (int i = 0; i < a->count; i++) {
+    const WindowInfo *wa = &a->windows[i];
+    const WindowInfo *wb = &b->windows[i];
+    if (wa->group_count != wb->group_count ||
+        strcmp(wa->address ? wa->address : "",
+               wb->address ? wb->address : "") != 0 ||
+        strcmp(wa->title ? wa->title : "", wb->title ? wb->title : "") != 0 ||
+        strcmp(wa->class_name ? wa->class_name : "",
+               wb->class_name ? wb->class_name : "") != 0)
+      return false;
+  }
+  return true;
+}
+
+/* Attach the pre-rendered frame if it shows exactly the pending state */
+static bool attach_ready_frame(uint32_t width, uint32_t height) {
+  ShmBuffer *buf = ready.buf;
+  if (!buf)
+    return false;
+
+  /* Content changes (thumbnails, invalidations) since it was drawn bump
+   * the serial; same_panel() only compares the windows */
+  if (ready.pool_slot != pool_slot || ready.scale120 != output_scale120 ||
+      buf->width != width || buf->height != height ||
+      ready.plain != layered || ready.content_serial != content_serial ||
+      !same_panel(&ready.state, pending_state)) {
+    LOG("Pre-rendered frame is stale");
+    drop_ready_frame();
+    /* The render thread's view state was for the prediction */
+    reset_view = true;
+    content_serial++;
+    return false;
+  }
+
+  /* Later frames patch this one like any frame the thread drew */
+  last_count = pending_state->count;
+  show_grid(pending_state, buf, ready.scale120, ready.content_serial,
+            ready.first_row, ready.plain);
+  commit_buffer(buf, pending_state, NULL, 0);
+  LOG("Attached pre-rendered frame");
+
+  app_state_free(&ready.state);
+  memset(&ready, 0, sizeof(ready)); /* Buffer stays busy: now attached */
+  dirty = false;
+  animating = false;
+  return true;
+}
+
+void render_toggle_hud(void) {
+  hud_enabled = !hud_enabled;
+  LOG("Debug overlay %s", hud_enabled ? "on" : "off");
+  /* Frames drawn either way must not be patched into the other */
+  content_serial++;
+  drop_ready_frame();
+  show_pending = false;
+  show_ms = -1;
+}
+
+void render_note_show(void) {
+  if (!hud_enabled)
+    return;
+  clock_gettime(CLOCK_MONOTONIC, &show_requested);
+  show_pending = true;
+  show_ms = -1;
+  icons_get_stats(&icon_hits_at_show, &icon_misses_at_show);
+}
+
+/* Numbers for the overlay of the frame about to be drawn */
+static void gather_hud_stats(HudStats *s) {
+  memset(s, 0, sizeof(HudStats));
+  s->last_ms = stats_last_frame_ms();
+  s->p99_ms = stats_p99_frame_ms();
+  s->quality = governor_tier_name(stats_last_tier());
+  s->show_ms = show_pending ? -1 : show_ms;
+
+  unsigned long hits, misses;
+  icons_get_stats(&hits, &misses);
+  s->icon_hits = hits - icon_hits_at_show;
+  s->icon_misses = misses - icon_misses_at_show;
+
+  for (int i = 0; i < POOL_COUNT; i++) {
+    if (!pools_ready[i])
+      continue;
+    bool used = false;
+    for (int k = 0; k < BUFFER_POOL_SIZE; k++) {
+      const ShmBuffer *b = &pools[i].buffers[k];
+      s->pool_bytes += b->capacity;
+      used = used || b->wl_buffer;
+      if (i == pool_slot && b->wl_buffer) {
+        s->buffers_allocated++;
+        s->buffers_busy += b->busy;
+      }
+    }
+    s->pools += used;
+  }
+}
+
+/* Snapshot state into the next job slot, with a free buffer of width x
+ * height marked busy for it. NULL if no buffer is free. */
+static RenderJob *start_job(AppState *state, uint32_t width,
+                            uint32_t height) {
+  if (!pools_ready[pool_slot]) {
+    buffer_pool_init(&pools[pool_slot], shm);
+    pools_ready[pool_slot] = true;
+  }
+
+  ShmBuffer *buf = buffer_pool_acquire(&pools[pool_slot], width, height);
+  if (!buf)
+    return NULL;
+
+  RenderJob *job = &jobs[next_job];
+  if (app_state_copy(&job->state, state) < 0) {
+    LOG("Out of memory copying window list");
+    return NULL;
+  }
+  next_job ^= 1;
+
+  job->buf = buf;
+  job->pool_slot = pool_slot;
+  job->scale120 = output_scale120;
+  job->content_serial = content_serial;
+  job->generation = generation;
+  job->reset_view = reset_view;
+  job->plain = layered;
+  job->invalidations = invalidations;
+  job->invalidation_count = invalidation_count;
+  reset_view = false;
+  invalidations = NULL;
+  invalidation_count = 0;
+  invalidation_capacity = 0;
+
+  in_flight = job;
+  buffer_pool_mark_busy(buf); /* Ours until the compositor releases it */
+  job->shown = shown_grid;
+  job->hud = hud_enabled;
+  if (hud_enabled)
+    gather_hud_stats(&job->hud_stats);
+  return job;
+}
+
+static void submit_job(RenderJob *job) {
+  if (threaded) {
+    render_thread_submit(job);
+  } else {
+    render_job(job);
+    finish_job(job);
+  }
+}
+
+void render_dispatch(void) {
+  /* One frame in flight at a time; input arriving meanwhile is folded
+   * into the next snapshot */
+  if (in_flight || !dirty || !pending_state || !surface)
+    return;
+
+  if (frame_callback) {
+    if (ms_since(&frame_requested_at) < FRAME_CALLBACK_TIMEOUT_MS)
+      return;
+    wl_callback_destroy(frame_callback);
+    frame_callback = NULL;
+  }
+
+  /* Render at the output's pixel density; the viewport maps the buffer
+   * back onto the logical surface size */
+  uint32_t width = (pending_state->width * output_scale120 + 60) / 120;
+  uint32_t height = (pending_state->height * output_scale120 + 60) / 120;
+
+  update_layered();
+  if (attach_ready_frame(width, height))
+    return;
+
+  /* A different window count means a different grid */
+  if (pending_state->count != last_count) {
+    last_count = pending_state->count;
+    content_serial++;
+  }
+
+  if (move_highlight(width, height))
+    return;
+
+  /* Stays dirty when no buffer is free; retried on the next dispatch */
+  RenderJob *job = start_job(pending_state, width, height);
+  if (!job)
+    return;
+
+  dirty = false;
+  submit_job(job);
+}
+
+bool render_prerender(AppState *state) {
+  if (in_flight)
+    return false;
+
+  uint32_t width = (state->width * output_scale120 + 60) / 120;
+  uint32_t height = (state->height * output_scale120 + 60) / 120;
+
+  /* Nothing the panel shows has changed */
+  update_layered();
+  if (ready.buf && ready.pool_slot == pool_slot &&
+      ready.scale120 == output_scale120 && ready.buf->width == width &&
+      ready.buf->height == height && ready.plain == layered &&
+      ready.content_serial == content_serial &&
+      same_panel(&ready.state, state))
+    return true;
+
+  /* The prediction is a grid of its own */
+  content_serial++;
+  last_count = state->count;
+
+  RenderJob *job = start_job(state, width, height);
+  if (!job)
+    return false;
+
+  job->speculative = true;
+  submit_job(job);
+  return true;
+}
+
+void render_forget_output(int slot) {
+  int i = pool_index(slot);
+  if (!pools_ready[i])
+    return;
+
+  if (ready.buf && ready.pool_slot == i)
+    drop_ready_frame();
+  /* Still being drawn into: the pool is reused by the next output that
+   * takes the slot, or freed at cleanup */
+  if (in_flight && in_flight->pool_slot == i)
+    return;
+
+  buffer_pool_finish(&pools[i]);
+  pools_ready[i] = false;
+}
+
+void render_reset_frame_state(void) {
+  if (frame_callback) {
+    wl_callback_destroy(frame_callback);
+    frame_callback = NULL;
+  }
+  dirty = false;
+  pending_state = NULL;
+  animating = false;
+  reset_view = true;
+  shown_grid.drawn = false;
+  shown_grid.valid = false;
+  generation++;
+  /* The next show draws a fresh grid unless it attaches a pre-render */
+  content_serial++;
+}
+
+void render_cleanup(void) {
+  render_thread_stop();
+  tiles_stop();
+  tile_threads = -1;
+  if (in_flight) {
+    in_flight->buf->busy = false;
+    release_job(in_flight);
+    in_flight = NULL;
+  }
+  threaded = false;
+  drop_ready_frame();
+
+  free_invalidations(invalidations, invalidation_count);
+  invalidations = NULL;
+  invalidation_count = 0;
+  invalidation_capacity = 0;
+
+  card_cache_clear();
+  sprites_cleanup();
+  engine_cleanup();
+  free_text();
+  layout_free(&grid_layout.layout);
+  grid_layout.valid = false;
+  layout_free(&shown_layout.layout);
+  shown_layout.valid = false;
+  for (int i = 0; i < POOL_COUNT; i++) {
+    if (pools_ready[i])
+      buffer_pool_finish(&pools[i]);
+    pools_ready[i] = false;
+  }
 }
@@ -5,12 +5,12 @@
 #include "config.h"
 #include "data.h"
 #include <stdint.h>
-#include <sys/types.h>
 #include <wayland-client.h>
 
 /* Shared Wayland objects needed for rendering */
 extern struct wl_shm *shm;
 extern struct wl_surface *surface;
+extern struct wp_viewport *viewport; /* NULL without wp_viewporter */
 
 /* Set config for rendering */
 void render_set_config(Config *config);
@@ -18,10 +18,72 @@ void render_set_config(Config *config);
 /* Calculate optimal window dimensions based on window count */
 void calculate_dimensions(AppState *state, uint32_t *width, uint32_t *height);
 
-/* Render the window switcher UI */
-void render_ui(AppState *state, uint32_t width, uint32_t height);
+/* Logical size of the output the panel opens on, which bounds how many
+ * columns and rows the grid gets (0 = unknown, no bound) */
+void render_set_output_size(int width, int height);
 
-/* Create a shared memory file for Wayland buffers */
-int create_shm_file(off_t size);
+/* Output the next frames are for (slot from outputs.h, -1 = unknown).
+ * Each output keeps its own buffers, so switching back and forth between
+ * monitors reallocates nothing. */
+void render_set_output(int slot);
+
+/* Free the buffers of an output that went away */
+void render_forget_output(int slot);
+
+/* Set the preferred buffer scale in 1/120 units (120 = 1x) */
+void render_set_scale(uint32_t scale120);
+
+/* Start the render thread (falls back to drawing inline if it cannot) */
+void render_init(void);
+
+/* Readable when the render thread has a finished frame, -1 if inline */
+int render_get_fd(void);
+
+/* Attach and commit the frame the render thread finished */
+void render_handle_completion(void);
+
+/* Mark the UI as needing a redraw; never rasterizes by itself */
+void render_schedule(AppState *state);
+
+/* Hand the pending frame to the render thread if the compositor is ready
+ * for one and no frame is in flight (call once per event loop iteration,
+ * after input has been handled) */
+void render_dispatch(void);
+
+/* Render state (device size from its width and height) in the background
+ * while the panel is hidden, and keep the frame for render_dispatch() to
+ * attach if the next show matches it exactly. Returns false if the render
+ * thread is busy and the caller should retry later. */
+bool render_prerender(AppState *state);
+
+/* Forget pending frames and callbacks (surface hidden or destroyed) */
+void render_reset_frame_state(void);
+
+/* Drop cached rendering for a window whose title or app_id changed.
+ * old_title is the title being replaced, or NULL if it did not change. */
+void render_window_changed(const char *identifier, const char *old_title);
+
+/* Card under a point in surface coordinates (logical pixels) of the
+ * frame on screen, or -1. Constant time: the grid is not searched. */
+int render_hit_test(const AppState *state, double x, double y);
+
+/* Show or hide the debug overlay (starts as the config says) */
+void render_toggle_hud(void);
+
+/* A show was requested: the overlay times it to the first commit */
+void render_note_show(void);
+
+/* Force a full repaint on the next frame (window list changed) */
+void render_invalidate(void);
+
+/* Draw state into caller memory (ARGB32, width x height device pixels at
+ * the current scale) on the calling thread, without a surface. For
+ * benchmarks and tools only: must not be used once render_init() ran.
+ * Returns the time spent in ms. */
+double render_to_memory(AppState *state, unsigned char *data, uint32_t width,
+                        uint32_t height, int stride);
+
+/* Release the buffer pool and other render resources */
+void render_cleanup(void);
 
 #endif /* RENDER_H */
@@ -0,0 +1,122 @@
+/* src/render_thread.c - Off-thread Frame Rasterization
+ *
+ * Jobs are handed over through two atomic pointer slots, one in each
+ * direction, so neither thread ever waits on a lock held by the other.
+ * eventfds only carry wakeups: the render thread sleeps on one, and the
+ * main loop polls the other next to the Wayland socket.
+ */
+#define _GNU_SOURCE
+
+#include "render_thread.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define LOG(fmt, ...)                                                          \
+  fprintf(stderr, "[RenderThread] " fmt "\n", ##__VA_ARGS__)
+
+static pthread_t thread;
+static bool running = false;
+static render_job_fn job_fn = NULL;
+static void (*exit_hook)(void) = NULL;
+
+static _Atomic(void *) submitted = NULL;
+static _Atomic(void *) completed = NULL;
+static atomic_bool quit = false;
+
+static int wake_fd = -1; /* Main -> render: a job or quit is pending */
+static int done_fd = -1; /* Render -> main: a job has completed */
+
+static void signal_fd(int fd) {
+  uint64_t one = 1;
+  while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR)
+    ;
+}
+
+static void *thread_main(void *arg) {
+  (void)arg;
+  while (!atomic_load(&quit)) {
+    uint64_t count;
+    if (read(wake_fd, &count, sizeof(count)) < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG("Wakeup read failed: %s", strerror(errno));
+      break;
+    }
+
+    void *job = atomic_exchange(&submitted, NULL);
+    if (!job)
+      continue;
+
+    job_fn(job);
+    atomic_store(&completed, job);
+    signal_fd(done_fd);
+  }
+
+  if (exit_hook)
+    exit_hook();
+  return NULL;
+}
+
+bool render_thread_start(render_job_fn fn, void (*thread_exit)(void)) {
+  if (running)
+    return true;
+
+  job_fn = fn;
+  exit_hook = thread_exit;
+  wake_fd = eventfd(0, EFD_CLOEXEC);
+  done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wake_fd < 0 || done_fd < 0) {
+    LOG("eventfd failed: %s", strerror(errno));
+    render_thread_stop();
+    return false;
+  }
+
+  atomic_store(&quit, false);
+  int err = pthread_create(&thread, NULL, thread_main, NULL);
+  if (err != 0) {
+    LOG("pthread_create failed: %s", strerror(err));
+    render_thread_stop();
+    return false;
+  }
+
+  running = true;
+  LOG("Started");
+  return true;
+}
+
+void render_thread_submit(void *job) {
+  atomic_store(&submitted, job);
+  signal_fd(wake_fd);
+}
+
+void *render_thread_take_completed(void) {
+  /* Clear the wakeup; the slot itself says whether a job is done */
+  uint64_t count;
+  if (done_fd >= 0 && read(done_fd, &count, sizeof(count)) < 0 &&
+      errno != EAGAIN)
+    LOG("Completion read failed: %s", strerror(errno));
+  return atomic_exchange(&completed, NULL);
+}
+
+int render_thread_get_fd(void) { return running ? done_fd : -1; }
+
+void render_thread_stop(void) {
+  if (running) {
+    atomic_store(&quit, true);
+    signal_fd(wake_fd);
+    pthread_join(thread, NULL);
+    running = false;
+  }
+  if (wake_fd >= 0)
+    close(wake_fd);
+  if (done_fd >= 0)
+    close(done_fd);
+  wake_fd = -1;
+  done_fd = -1;
+}
@@ -0,0 +1,28 @@
+/* src/render_thread.h - Off-thread Frame Rasterization */
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <stdbool.h>
+
+/* Rasterizes one job; runs on the render thread */
+typedef void (*render_job_fn)(void *job);
+
+/* Start the render thread. thread_exit, if set, runs on it before it
+ * exits. Returns false if it could not be started, in which case callers
+ * should run jobs inline. */
+bool render_thread_start(render_job_fn fn, void (*thread_exit)(void));
+
+/* Hand a job to the render thread. The caller must not touch it until it
+ * comes back from render_thread_take_completed(). Never blocks. */
+void render_thread_submit(void *job);
+
+/* Finished job, or NULL. Never blocks. */
+void *render_thread_take_completed(void);
+
+/* Becomes readable when a job has completed (-1 without a thread) */
+int render_thread_get_fd(void);
+
+/* Stop and join the thread; a job in progress is finished first */
+void render_thread_stop(void);
+
+#endif /* RENDER_THREAD_H */
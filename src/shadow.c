@@ -0,0 +1,316 @@
+/* src/shadow.c - Blurred Drop Shadows
+ *
+ * A Gaussian blur is too slow to run per frame, so shadows are computed
+ * once for a minimal rounded rectangle and stretched as 9-slices. The blur
+ * itself is three separable box passes. Every pass walks the image row by
+ * row keeping one running sum per column, which vectorizes across columns;
+ * horizontal passes run on a transposed copy so they can use the same
+ * kernel.
+ */
+#include "shadow.h"
+#include "sprites.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#define LOG(fmt, ...) fprintf(stderr, "[Shadow] " fmt "\n", ##__VA_ARGS__)
+
+/* One vertical box pass: dst = mean of src rows [y - r, y + r].
+ * sums holds a 16-bit running total per column; (2r + 1) * 255 must fit,
+ * so radius is limited to 127. mul is 65536 / (2r + 1). */
+typedef void (*BoxPassFn)(const uint8_t *src, uint8_t *dst, uint16_t *sums,
+                          int width, int height, int stride, int radius,
+                          uint16_t mul);
+
+#define MAX_RADIUS 127
+
+/* Add the row entering the window and drop the one leaving it */
+static inline void scalar_columns(const uint8_t *in, const uint8_t *out,
+                                  uint8_t *dst, uint16_t *sums, int from,
+                                  int to, uint16_t mul) {
+  for (int x = from; x < to; x++) {
+    dst[x] = (uint8_t)(((uint32_t)sums[x] * mul) >> 16);
+    sums[x] += (in ? in[x] : 0) - (out ? out[x] : 0);
+  }
+}
+
+static void prime_sums(const uint8_t *src, uint16_t *sums, int width,
+                       int height, int stride, int radius) {
+  memset(sums, 0, width * sizeof(uint16_t));
+  for (int y = 0; y <= radius && y < height; y++) {
+    const uint8_t *row = src + (size_t)y * stride;
+    for (int x = 0; x < width; x++)
+      sums[x] += row[x];
+  }
+}
+
+/* Rows entering and leaving the window after output row y (NULL outside
+ * the image) */
+static inline void window_rows(const uint8_t *src, int y, int height,
+                               int stride, int radius, const uint8_t **in,
+                               const uint8_t **out) {
+  int yin = y + radius + 1;
+  int yout = y - radius;
+  *in = yin < height ? src + (size_t)yin * stride : NULL;
+  *out = yout >= 0 ? src + (size_t)yout * stride : NULL;
+}
+
+static void box_pass_scalar(const uint8_t *src, uint8_t *dst, uint16_t *sums,
+                            int width, int height, int stride, int radius,
+                            uint16_t mul) {
+  prime_sums(src, sums, width, height, stride, radius);
+  for (int y = 0; y < height; y++) {
+    const uint8_t *in, *out;
+    window_rows(src, y, height, stride, radius, &in, &out);
+    scalar_columns(in, out, dst + (size_t)y * stride, sums, 0, width, mul);
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2"))) static void
+box_pass_sse2(const uint8_t *src, uint8_t *dst, uint16_t *sums, int width,
+              int height, int stride, int radius, uint16_t mul) {
+  prime_sums(src, sums, width, height, stride, radius);
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i vmul = _mm_set1_epi16((short)mul);
+  int simd_w = width & ~7;
+
+  for (int y = 0; y < height; y++) {
+    const uint8_t *in, *out;
+    window_rows(src, y, height, stride, radius, &in, &out);
+    uint8_t *d = dst + (size_t)y * stride;
+
+    for (int x = 0; x < simd_w; x += 8) {
+      __m128i sum = _mm_loadu_si128((const __m128i *)(sums + x));
+      __m128i mean = _mm_mulhi_epu16(sum, vmul);
+      _mm_storel_epi64((__m128i *)(d + x), _mm_packus_epi16(mean, zero));
+
+      if (in) {
+        __m128i v = _mm_loadl_epi64((const __m128i *)(in + x));
+        sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(v, zero));
+      }
+      if (out) {
+        __m128i v = _mm_loadl_epi64((const __m128i *)(out + x));
+        sum = _mm_sub_epi16(sum, _mm_unpacklo_epi8(v, zero));
+      }
+      _mm_storeu_si128((__m128i *)(sums + x), sum);
+    }
+    scalar_columns(in, out, d, sums, simd_w, width, mul);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+box_pass_avx2(const uint8_t *src, uint8_t *dst, uint16_t *sums, int width,
+              int height, int stride, int radius, uint16_t mul) {
+  prime_sums(src, sums, width, height, stride, radius);
+
+  const __m256i vmul = _mm256_set1_epi16((short)mul);
+  int simd_w = width & ~15;
+
+  for (int y = 0; y < height; y++) {
+    const uint8_t *in, *out;
+    window_rows(src, y, height, stride, radius, &in, &out);
+    uint8_t *d = dst + (size_t)y * stride;
+
+    for (int x = 0; x < simd_w; x += 16) {
+      __m256i sum = _mm256_loadu_si256((const __m256i *)(sums + x));
+      __m256i mean = _mm256_mulhi_epu16(sum, vmul);
+      /* packus works per 128-bit lane: fold the upper half down */
+      __m128i lo = _mm256_castsi256_si128(mean);
+      __m128i hi = _mm256_extracti128_si256(mean, 1);
+      _mm_storeu_si128((__m128i *)(d + x), _mm_packus_epi16(lo, hi));
+
+      if (in) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + x));
+        sum = _mm256_add_epi16(sum, _mm256_cvtepu8_epi16(v));
+      }
+      if (out) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(out + x));
+        sum = _mm256_sub_epi16(sum, _mm256_cvtepu8_epi16(v));
+      }
+      _mm256_storeu_si256((__m256i *)(sums + x), sum);
+    }
+    scalar_columns(in, out, d, sums, simd_w, width, mul);
+  }
+}
+#endif
+
+static BoxPassFn box_pass_for(ShadowKernel kernel) {
+#ifdef HAVE_X86_SIMD
+  if (kernel == SHADOW_KERNEL_AVX2)
+    return box_pass_avx2;
+  if (kernel == SHADOW_KERNEL_SSE2)
+    return box_pass_sse2;
+#endif
+  (void)kernel;
+  return box_pass_scalar;
+}
+
+bool shadow_kernel_supported(ShadowKernel kernel) {
+  switch (kernel) {
+  case SHADOW_KERNEL_SCALAR:
+    return true;
+#ifdef HAVE_X86_SIMD
+  case SHADOW_KERNEL_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  case SHADOW_KERNEL_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+ShadowKernel shadow_best_kernel(void) {
+  static int best = -1;
+  if (best < 0) {
+    best = SHADOW_KERNEL_SCALAR;
+    for (int k = SHADOW_KERNEL_COUNT - 1; k > SHADOW_KERNEL_SCALAR; k--) {
+      if (shadow_kernel_supported(k)) {
+        best = k;
+        break;
+      }
+    }
+  }
+  return (ShadowKernel)best;
+}
+
+const char *shadow_kernel_name(ShadowKernel kernel) {
+  switch (kernel) {
+  case SHADOW_KERNEL_SSE2:
+    return "sse2";
+  case SHADOW_KERNEL_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+/* Transpose in tiles so both sides stay in cache */
+#define TRANSPOSE_TILE 32
+
+static void transpose(const uint8_t *src, int src_stride, uint8_t *dst,
+                      int dst_stride, int width, int height) {
+  for (int ty = 0; ty < height; ty += TRANSPOSE_TILE) {
+    int y_end = ty + TRANSPOSE_TILE < height ? ty + TRANSPOSE_TILE : height;
+    for (int tx = 0; tx < width; tx += TRANSPOSE_TILE) {
+      int x_end = tx + TRANSPOSE_TILE < width ? tx + TRANSPOSE_TILE : width;
+      for (int y = ty; y < y_end; y++) {
+        const uint8_t *row = src + (size_t)y * src_stride;
+        for (int x = tx; x < x_end; x++)
+          dst[(size_t)x * dst_stride + y] = row[x];
+      }
+    }
+  }
+}
+
+/* Three vertical passes, ping-ponging through tmp; result ends in data */
+static void blur_columns(BoxPassFn pass, uint8_t *data, uint8_t *tmp,
+                         uint16_t *sums, int width, int height, int stride,
+                         int radius, uint16_t mul) {
+  pass(data, tmp, sums, width, height, stride, radius, mul);
+  pass(tmp, data, sums, width, height, stride, radius, mul);
+  pass(data, tmp, sums, width, height, stride, radius, mul);
+  for (int y = 0; y < height; y++)
+    memcpy(data + (size_t)y * stride, tmp + (size_t)y * stride, width);
+}
+
+void shadow_blur_a8(ShadowKernel kernel, uint8_t *data, int width,
+                    int height, int stride, int radius) {
+  if (radius <= 0 || width <= 0 || height <= 0)
+    return;
+  if (radius > MAX_RADIUS)
+    radius = MAX_RADIUS;
+  if (!shadow_kernel_supported(kernel))
+    kernel = SHADOW_KERNEL_SCALAR;
+
+  BoxPassFn pass = box_pass_for(kernel);
+  uint16_t mul = (uint16_t)((65536 + radius) / (2 * radius + 1));
+  int side = width > height ? width : height;
+
+  /* Scratch: a transposed copy, its ping-pong buffer and the sums */
+  size_t area = (size_t)width * height;
+  size_t padded = (size_t)height * stride;
+  uint8_t *t = malloc(area);
+  uint8_t *tmp = malloc(padded > area ? padded : area);
+  uint16_t *sums = malloc(side * sizeof(uint16_t));
+  if (!t || !tmp || !sums) {
+    LOG("Out of memory blurring %dx%d", width, height);
+    free(t);
+    free(tmp);
+    free(sums);
+    return;
+  }
+
+  /* Vertical, then horizontal on the transposed image */
+  blur_columns(pass, data, tmp, sums, width, height, stride, radius, mul);
+  transpose(data, stride, t, height, width, height);
+  blur_columns(pass, t, tmp, sums, height, width, height, radius, mul);
+  transpose(t, height, data, stride, height, width);
+
+  free(t);
+  free(tmp);
+  free(sums);
+}
+
+cairo_surface_t *shadow_create(int radius, int blur, double opacity,
+                               int *inset, int *reach) {
+  *inset = 0;
+  *reach = 0;
+  if (blur <= 0)
+    return NULL;
+
+  /* Three passes of radius r reach 3r */
+  int box = blur / 3 > 0 ? blur / 3 : 1;
+  int extent = 3 * box;
+
+  /* Corners of the blurred shape cover radius + 2 * extent; the rectangle
+   * leaves exactly one stretchable row and column between them */
+  int rect = 2 * (radius + extent) + 1;
+  int size = rect + 2 * extent;
+
+  cairo_surface_t *mask =
+      cairo_image_surface_create(CAIRO_FORMAT_A8, size, size);
+  if (cairo_surface_status(mask) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(mask);
+    return NULL;
+  }
+
+  cairo_t *cr = cairo_create(mask);
+  cairo_set_source_rgba(cr, 0, 0, 0, 1);
+  draw_rounded_rect(cr, extent, extent, rect, rect, radius);
+  cairo_fill(cr);
+  cairo_destroy(cr);
+
+  cairo_surface_flush(mask);
+  uint8_t *alpha = cairo_image_surface_get_data(mask);
+  int alpha_stride = cairo_image_surface_get_stride(mask);
+  shadow_blur_a8(shadow_best_kernel(), alpha, size, size, alpha_stride, box);
+  cairo_surface_mark_dirty(mask);
+
+  /* Premultiplied black at the requested opacity */
+  cairo_surface_t *shadow =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+  if (cairo_surface_status(shadow) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(shadow);
+    cairo_surface_destroy(mask);
+    return NULL;
+  }
+  cr = cairo_create(shadow);
+  cairo_set_source_rgba(cr, 0, 0, 0, opacity);
+  cairo_mask_surface(cr, mask, 0, 0);
+  cairo_destroy(cr);
+  cairo_surface_destroy(mask);
+
+  *inset = radius + 2 * extent;
+  *reach = extent;
+  return shadow;
+}
@@ -0,0 +1,36 @@
+/* src/shadow.h - Blurred Drop Shadows */
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <cairo/cairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Box blur implementations, selected at runtime */
+typedef enum {
+  SHADOW_KERNEL_SCALAR,
+  SHADOW_KERNEL_SSE2,
+  SHADOW_KERNEL_AVX2,
+  SHADOW_KERNEL_COUNT
+} ShadowKernel;
+
+/* Fastest kernel this CPU supports */
+ShadowKernel shadow_best_kernel(void);
+bool shadow_kernel_supported(ShadowKernel kernel);
+const char *shadow_kernel_name(ShadowKernel kernel);
+
+/* Blur an A8 image in place with three separable box passes of the given
+ * radius (close to a Gaussian reaching 3 * radius). Pixels outside the
+ * image count as transparent. */
+void shadow_blur_a8(ShadowKernel kernel, uint8_t *data, int width,
+                    int height, int stride, int radius);
+
+/* Shadow of a rounded rectangle blurred by about blur pixels, made small
+ * enough to be drawn as a 9-slice: *inset is the corner size, with one
+ * stretchable pixel between corners, and *reach how far the shadow extends
+ * past the rectangle. Returns a black ARGB32 image with the given opacity,
+ * or NULL if blur is 0. */
+cairo_surface_t *shadow_create(int radius, int blur, double opacity,
+                               int *inset, int *reach);
+
+#endif /* SHADOW_H */
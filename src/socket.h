@@ -14,6 +14,7 @@
 #define CMD_TOGGLE "TOGGLE"
 #define CMD_HIDE "HIDE"
 #define CMD_QUIT "QUIT"
+#define CMD_HUD "HUD"
 
 /* Server functions (daemon) */
 int init_server(void);
@@ -0,0 +1,403 @@
+/* src/sprites.c - Pre-rasterized Chrome Sprite Sheet
+ *
+ * Rounded rectangles, strokes and circles are tessellated and antialiased
+ * once per config into a single image. Panel and card chrome are stored as
+ * minimal 9-slice sources (corners plus a one pixel wide middle) so they can
+ * be stretched to any size; the badge and letter tiles are stored whole.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define _USE_MATH_DEFINES
+
+#include "sprites.h"
+#include "shadow.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define LOG(fmt, ...) fprintf(stderr, "[Sprites] " fmt "\n", ##__VA_ARGS__)
+
+/* Transparent gap between sprites so filtering never bleeds across */
+#define SPRITE_SPACING 2
+#define BADGE_RADIUS 10
+
+/* Shadow strength: the panel floats above windows, cards above the panel */
+#define PANEL_SHADOW_OPACITY 0.35
+#define CARD_SHADOW_OPACITY 0.3
+
+/* Palette for letter icon fallbacks */
+static const uint32_t letter_colors[SPRITES_NUM_LETTER_COLORS] = {
+    0xe78284, /* Red */
+    0xa6d189, /* Green */
+    0x8caaee, /* Blue */
+    0xca9ee6, /* Mauve */
+    0xe5c890, /* Yellow */
+    0x81c8be, /* Teal */
+    0xf4b8e4, /* Pink */
+};
+
+/* Sheets for different output scales are kept side by side */
+#define MAX_SHEETS 4
+
+/* Everything from Config that shows up in the sheet */
+typedef struct {
+  uint32_t background;
+  uint32_t card_bg;
+  uint32_t card_selected;
+  uint32_t border_color;
+  int card_radius;
+  int border_width;
+  int icon_size;
+  int icon_radius;
+  int shadow_size;
+  uint32_t scale120;
+} SpriteKey;
+
+typedef struct {
+  int x, y;  /* Position in the sheet */
+  int w, h;  /* Source size */
+  int inset; /* Corner size for 9-slice sprites, 0 for fixed sprites */
+} Sprite;
+
+typedef struct {
+  SpriteKey key;
+  cairo_surface_t *surface;
+  Sprite sprites[SPRITE_COUNT];
+  int card_margin;
+  int badge_radius;
+  int panel_shadow_reach;
+  int card_shadow_reach;
+  unsigned long access_time; /* LRU timestamp */
+} SpriteSheet;
+
+static SpriteSheet sheets[MAX_SHEETS];
+static SpriteSheet *current = NULL;
+static unsigned long lru_counter = 0;
+
+void draw_rounded_rect(cairo_t *cr, double x, double y, double w, double h,
+                       double r) {
+  cairo_new_path(cr); /* Critical: reset path */
+
+  if (r > w / 2)
+    r = w / 2;
+  if (r > h / 2)
+    r = h / 2;
+
+  cairo_arc(cr, x + r, y + r, r, M_PI, 3 * M_PI / 2);
+  cairo_arc(cr, x + w - r, y + r, r, 3 * M_PI / 2, 0);
+  cairo_arc(cr, x + w - r, y + h - r, r, 0, M_PI / 2);
+  cairo_arc(cr, x + r, y + h - r, r, M_PI / 2, M_PI);
+  cairo_close_path(cr);
+}
+
+static void key_from_config(const Config *cfg, uint32_t scale120,
+                            SpriteKey *key) {
+  memset(key, 0, sizeof(SpriteKey));
+  key->scale120 = scale120;
+  key->background = cfg ? cfg->background : 0x1a1a33;
+  key->card_bg = cfg ? cfg->card_bg : 0x313244;
+  key->card_selected = cfg ? cfg->card_selected : 0x45475a;
+  key->border_color = cfg ? cfg->border_color : 0x89b4fa;
+  key->card_radius = cfg ? cfg->card_radius : 12;
+  key->border_width = cfg ? cfg->border_width : 2;
+  key->icon_size = cfg ? cfg->icon_size : 64;
+  key->icon_radius = cfg ? cfg->icon_radius : 12;
+  key->shadow_size = cfg ? cfg->shadow_size : 12;
+}
+
+static void set_source_color(cairo_t *cr, uint32_t color, double alpha) {
+  double r, g, b;
+  color_to_rgb(color, &r, &g, &b);
+  cairo_set_source_rgba(cr, r, g, b, alpha);
+}
+
+static void draw_panel(cairo_t *cr, const Sprite *s, const SpriteKey *k) {
+  int rad = s->inset;
+  set_source_color(cr, k->background, 0.95);
+  draw_rounded_rect(cr, s->x, s->y, s->w, s->h, rad);
+  cairo_fill(cr);
+
+  /* Border: one logical pixel */
+  double line = k->scale120 >= 240 ? k->scale120 / 120 : 1;
+  set_source_color(cr, k->border_color, 0.3);
+  cairo_set_line_width(cr, line);
+  draw_rounded_rect(cr, s->x + line / 2, s->y + line / 2, s->w - line,
+                    s->h - line, rad);
+  cairo_stroke(cr);
+}
+
+static void draw_card_chrome(cairo_t *cr, const Sprite *s, const SpriteKey *k,
+                             int margin, bool selected) {
+  double x = s->x + margin;
+  double y = s->y + margin;
+  double w = s->w - 2 * margin;
+  double h = s->h - 2 * margin;
+
+  set_source_color(cr, selected ? k->card_selected : k->card_bg, 1.0);
+  draw_rounded_rect(cr, x, y, w, h, k->card_radius);
+  cairo_fill(cr);
+
+  /* Border */
+  if (selected) {
+    set_source_color(cr, k->border_color, 1.0);
+    cairo_set_line_width(cr, k->border_width);
+    draw_rounded_rect(cr, x, y, w, h, k->card_radius);
+    cairo_stroke(cr);
+  }
+}
+
+static void draw_badge(cairo_t *cr, const Sprite *s, const SpriteKey *k,
+                       int radius) {
+  set_source_color(cr, k->border_color, 1.0);
+  cairo_new_path(cr);
+  cairo_arc(cr, s->x + s->w / 2.0, s->y + s->h / 2.0, radius, 0, 2 * M_PI);
+  cairo_fill(cr);
+}
+
+static void draw_letter_tile(cairo_t *cr, const Sprite *s, const SpriteKey *k,
+                             uint32_t color) {
+  set_source_color(cr, color, 1.0);
+  draw_rounded_rect(cr, s->x, s->y, s->w, s->h, k->icon_radius);
+  cairo_fill(cr);
+}
+
+static void destroy_sheet(SpriteSheet *sh) {
+  if (sh->surface)
+    cairo_surface_destroy(sh->surface);
+  memset(sh, 0, sizeof(SpriteSheet));
+}
+
+static void build_sheet(SpriteSheet *sh, const SpriteKey *k) {
+  destroy_sheet(sh);
+  sh->key = *k;
+
+  double scale = k->scale120 / 120.0;
+  sh->card_margin = k->border_width / 2 + 1;
+  sh->badge_radius = (int)lround(BADGE_RADIUS * scale);
+
+  /* Source sizes: corners plus a single stretchable pixel */
+  Sprite *sp = sh->sprites;
+  int panel_inset = k->card_radius + (int)lround(4 * scale);
+  int card_inset = k->card_radius + sh->card_margin;
+  int badge = 2 * sh->badge_radius + 2;
+  int tile = k->icon_size > 0 ? k->icon_size : 1;
+
+  /* Shadows are blurred once here and then only stretched */
+  int panel_shadow_inset, card_shadow_inset;
+  cairo_surface_t *panel_shadow =
+      shadow_create(panel_inset, k->shadow_size, PANEL_SHADOW_OPACITY,
+                    &panel_shadow_inset, &sh->panel_shadow_reach);
+  cairo_surface_t *card_shadow =
+      shadow_create(k->card_radius, k->shadow_size / 2, CARD_SHADOW_OPACITY,
+                    &card_shadow_inset, &sh->card_shadow_reach);
+  sp[SPRITE_PANEL_SHADOW] = (Sprite){0, 0, 0, 0, 0};
+  sp[SPRITE_CARD_SHADOW] = (Sprite){0, 0, 0, 0, 0};
+  if (panel_shadow) {
+    int size = cairo_image_surface_get_width(panel_shadow);
+    sp[SPRITE_PANEL_SHADOW] = (Sprite){0, 0, size, size, panel_shadow_inset};
+  }
+  if (card_shadow) {
+    int size = cairo_image_surface_get_width(card_shadow);
+    sp[SPRITE_CARD_SHADOW] = (Sprite){0, 0, size, size, card_shadow_inset};
+  }
+
+  sp[SPRITE_PANEL] = (Sprite){0, 0, 2 * panel_inset + 1, 2 * panel_inset + 1,
+                              panel_inset};
+  sp[SPRITE_CARD] =
+      (Sprite){0, 0, 2 * card_inset + 1, 2 * card_inset + 1, card_inset};
+  sp[SPRITE_CARD_SELECTED] = sp[SPRITE_CARD];
+  sp[SPRITE_BADGE] = (Sprite){0, 0, badge, badge, 0};
+  for (int i = 0; i < SPRITES_NUM_LETTER_COLORS; i++)
+    sp[SPRITE_LETTER_FIRST + i] = (Sprite){0, 0, tile, tile, 0};
+
+  /* Pack in a single row */
+  int sheet_w = 0, sheet_h = 0;
+  for (int i = 0; i < SPRITE_COUNT; i++) {
+    sp[i].x = sheet_w;
+    sheet_w += sp[i].w + SPRITE_SPACING;
+    if (sp[i].h > sheet_h)
+      sheet_h = sp[i].h;
+  }
+
+  cairo_surface_t *surface =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, sheet_w, sheet_h);
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    LOG("Failed to allocate %dx%d sheet", sheet_w, sheet_h);
+    cairo_surface_destroy(surface);
+    if (panel_shadow)
+      cairo_surface_destroy(panel_shadow);
+    if (card_shadow)
+      cairo_surface_destroy(card_shadow);
+    return;
+  }
+
+  cairo_t *cr = cairo_create(surface);
+  cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
+
+  if (panel_shadow) {
+    cairo_set_source_surface(cr, panel_shadow, sp[SPRITE_PANEL_SHADOW].x, 0);
+    cairo_paint(cr);
+    cairo_surface_destroy(panel_shadow);
+  }
+  if (card_shadow) {
+    cairo_set_source_surface(cr, card_shadow, sp[SPRITE_CARD_SHADOW].x, 0);
+    cairo_paint(cr);
+    cairo_surface_destroy(card_shadow);
+  }
+
+  draw_panel(cr, &sp[SPRITE_PANEL], k);
+  draw_card_chrome(cr, &sp[SPRITE_CARD], k, sh->card_margin, false);
+  draw_card_chrome(cr, &sp[SPRITE_CARD_SELECTED], k, sh->card_margin, true);
+  draw_badge(cr, &sp[SPRITE_BADGE], k, sh->badge_radius);
+  for (int i = 0; i < SPRITES_NUM_LETTER_COLORS; i++)
+    draw_letter_tile(cr, &sp[SPRITE_LETTER_FIRST + i], k, letter_colors[i]);
+
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+  sh->surface = surface;
+  LOG("Rebuilt %dx%d sheet (scale %.2f)", sheet_w, sheet_h, scale);
+}
+
+bool sprites_update(const Config *config, uint32_t scale120) {
+  SpriteKey key;
+  key_from_config(config, scale120, &key);
+
+  if (current && current->surface &&
+      memcmp(&key, &current->key, sizeof(SpriteKey)) == 0) {
+    current->access_time = ++lru_counter;
+    return false;
+  }
+
+  /* Another output's sheet may already be built */
+  for (int i = 0; i < MAX_SHEETS; i++) {
+    if (sheets[i].surface &&
+        memcmp(&key, &sheets[i].key, sizeof(SpriteKey)) == 0) {
+      current = &sheets[i];
+      current->access_time = ++lru_counter;
+      return false;
+    }
+  }
+
+  /* A sheet at this scale with another key means the theme changed, which
+   * makes every sheet stale */
+  for (int i = 0; i < MAX_SHEETS; i++) {
+    if (sheets[i].surface && sheets[i].key.scale120 == scale120) {
+      for (int j = 0; j < MAX_SHEETS; j++)
+        destroy_sheet(&sheets[j]);
+      break;
+    }
+  }
+
+  /* Use a free slot, or evict the least recently used sheet */
+  SpriteSheet *slot = NULL;
+  for (int i = 0; i < MAX_SHEETS; i++) {
+    if (!sheets[i].surface) {
+      slot = &sheets[i];
+      break;
+    }
+    if (!slot || sheets[i].access_time < slot->access_time)
+      slot = &sheets[i];
+  }
+
+  build_sheet(slot, &key);
+  slot->access_time = ++lru_counter;
+  current = slot;
+  return true;
+}
+
+/* Copy a piece of the sheet onto its destination rectangle */
+static void blit_piece(cairo_t *cr, const SpritePiece *p, double alpha) {
+  cairo_save(cr);
+  cairo_rectangle(cr, p->dx, p->dy, p->dw, p->dh);
+  cairo_clip(cr);
+  cairo_translate(cr, p->dx, p->dy);
+  cairo_scale(cr, p->dw / p->sw, p->dh / p->sh);
+  cairo_set_source_surface(cr, current->surface, -p->sx, -p->sy);
+  /* Stretched pieces are one pixel wide: never interpolate with neighbours */
+  cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_NEAREST);
+  if (alpha >= 1.0)
+    cairo_paint(cr);
+  else
+    cairo_paint_with_alpha(cr, alpha);
+  cairo_restore(cr);
+}
+
+int sprites_pieces(SpriteId id, double x, double y, double w, double h,
+                   SpritePiece pieces[9]) {
+  if (!current || !current->surface || id < 0 || id >= SPRITE_COUNT)
+    return 0;
+
+  const Sprite *s = &current->sprites[id];
+
+  if (s->inset == 0) {
+    if (s->w <= 0 || s->h <= 0)
+      return 0;
+    pieces[0] = (SpritePiece){s->x, s->y, s->w, s->h, x, y, s->w, s->h};
+    return 1;
+  }
+
+  /* 9-slice: corners are copied, edges and middle stretched */
+  double in = s->inset;
+  if (in > w / 2)
+    in = floor(w / 2);
+  if (in > h / 2)
+    in = floor(h / 2);
+
+  double sx[3] = {s->x, s->x + s->inset, s->x + s->w - in};
+  double sw[3] = {in, s->w - 2 * s->inset, in};
+  double sy[3] = {s->y, s->y + s->inset, s->y + s->h - in};
+  double sh[3] = {in, s->h - 2 * s->inset, in};
+  double dx[3] = {x, x + in, x + w - in};
+  double dw[3] = {in, w - 2 * in, in};
+  double dy[3] = {y, y + in, y + h - in};
+  double dh[3] = {in, h - 2 * in, in};
+
+  int n = 0;
+  for (int row = 0; row < 3; row++) {
+    for (int col = 0; col < 3; col++) {
+      if (sw[col] <= 0 || sh[row] <= 0 || dw[col] <= 0 || dh[row] <= 0)
+        continue;
+      pieces[n++] = (SpritePiece){sx[col], sy[row], sw[col], sh[row],
+                                  dx[col], dy[row], dw[col], dh[row]};
+    }
+  }
+  return n;
+}
+
+cairo_surface_t *sprites_sheet(void) {
+  return current ? current->surface : NULL;
+}
+
+void sprites_draw(cairo_t *cr, SpriteId id, double x, double y, double w,
+                  double h, double alpha) {
+  SpritePiece pieces[9];
+  int n = sprites_pieces(id, x, y, w, h, pieces);
+  for (int i = 0; i < n; i++)
+    blit_piece(cr, &pieces[i], alpha);
+}
+
+int sprites_card_margin(void) { return current ? current->card_margin : 2; }
+
+int sprites_badge_size(void) {
+  return current ? 2 * current->badge_radius + 2 : 2 * BADGE_RADIUS + 2;
+}
+
+int sprites_shadow_reach(SpriteId id) {
+  if (!current)
+    return 0;
+  if (id == SPRITE_PANEL_SHADOW)
+    return current->panel_shadow_reach;
+  if (id == SPRITE_CARD_SHADOW)
+    return current->card_shadow_reach;
+  return 0;
+}
+
+void sprites_cleanup(void) {
+  for (int i = 0; i < MAX_SHEETS; i++)
+    destroy_sheet(&sheets[i]);
+  current = NULL;
+  lru_counter = 0;
+}
@@ -0,0 +1,68 @@
+/* src/sprites.h - Pre-rasterized Chrome Sprite Sheet */
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include "config.h"
+#include <cairo/cairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of letter-icon tile colors */
+#define SPRITES_NUM_LETTER_COLORS 7
+
+typedef enum {
+  SPRITE_PANEL_SHADOW,  /* Blurred shadow under the panel (9-slice) */
+  SPRITE_CARD_SHADOW,   /* Blurred shadow under the selected card (9-slice) */
+  SPRITE_PANEL,         /* Panel background and border (9-slice) */
+  SPRITE_CARD,          /* Card background (9-slice) */
+  SPRITE_CARD_SELECTED, /* Selected card background and border (9-slice) */
+  SPRITE_BADGE,         /* Group count badge circle */
+  SPRITE_LETTER_FIRST,  /* Letter-icon tiles, one per palette color */
+  SPRITE_COUNT = SPRITE_LETTER_FIRST + SPRITES_NUM_LETTER_COLORS
+} SpriteId;
+
+/* Select the sheet for a config (lengths already in buffer pixels) and
+ * output scale (1/120 units), rasterizing it if theme colors, radii, sizes
+ * or the scale changed. Returns true when a sheet was rebuilt. */
+bool sprites_update(const Config *config, uint32_t scale120);
+
+/* Draw a sprite. 9-slice sprites are stretched to w x h; fixed sprites
+ * (badge, letter tiles) ignore w and h. Card sprites include a margin of
+ * sprites_card_margin() around the card rectangle. */
+void sprites_draw(cairo_t *cr, SpriteId id, double x, double y, double w,
+                  double h, double alpha);
+
+/* A rectangle of the sheet and where it lands, in pixels */
+typedef struct {
+  double sx, sy, sw, sh; /* Source, in sprites_sheet() */
+  double dx, dy, dw, dh; /* Destination; stretched when sizes differ */
+} SpritePiece;
+
+/* The pieces sprites_draw() copies for a sprite, for compositing it
+ * without Cairo: one for fixed sprites, up to nine for 9-slice ones.
+ * Returns how many were written (0 without a sheet). */
+int sprites_pieces(SpriteId id, double x, double y, double w, double h,
+                   SpritePiece pieces[9]);
+
+/* The current sheet (ARGB32, flushed), or NULL before sprites_update() */
+cairo_surface_t *sprites_sheet(void);
+
+/* Room kept around card sprites for half the border stroke */
+int sprites_card_margin(void);
+
+/* Diameter of the badge sprite including antialiasing */
+int sprites_badge_size(void);
+
+/* How far a shadow sprite reaches past the shape casting it (0 when
+ * shadows are disabled). Draw it at the shape's rectangle grown by this
+ * much on every side. */
+int sprites_shadow_reach(SpriteId id);
+
+/* Rounded rectangle path, shared with the dynamic parts of the renderer */
+void draw_rounded_rect(cairo_t *cr, double x, double y, double w, double h,
+                       double r);
+
+/* Free the sheet */
+void sprites_cleanup(void);
+
+#endif /* SPRITES_H */
@@ -0,0 +1,102 @@
+/* src/stats.c - Frame Timing Statistics
+ *
+ * Render times go into a ring of recent samples for percentiles. The
+ * refresh interval is estimated as the shortest gap seen between frame
+ * callbacks, since that is the best the compositor has delivered.
+ */
+#include "stats.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Stats] " fmt "\n", ##__VA_ARGS__)
+#define MAX_SAMPLES 256
+
+static double samples[MAX_SAMPLES];
+static int sample_count = 0;
+static int sample_next = 0;
+
+static unsigned long frames = 0;
+static unsigned long over_budget = 0;
+static double budget = FRAME_BUDGET_MS; /* Of the last frame */
+static unsigned long dropped = 0;
+static unsigned long tier_frames[QUALITY_COUNT];
+static QualityTier last_tier = QUALITY_BEST;
+
+static uint32_t last_presented = 0;
+static bool have_presented = false;
+static uint32_t refresh_ms = 0; /* 0 until two callbacks were seen */
+
+void stats_record_frame(double render_ms, double budget_ms, QualityTier tier) {
+  samples[sample_next] = render_ms;
+  sample_next = (sample_next + 1) % MAX_SAMPLES;
+  if (sample_count < MAX_SAMPLES)
+    sample_count++;
+
+  frames++;
+  budget = budget_ms > 0 ? budget_ms : FRAME_BUDGET_MS;
+  if (render_ms > budget)
+    over_budget++;
+  tier_frames[tier]++;
+  last_tier = tier;
+}
+
+void stats_frame_presented(uint32_t time_ms) {
+  if (have_presented) {
+    uint32_t interval = time_ms - last_presented;
+    if (interval > 0 && (refresh_ms == 0 || interval < refresh_ms))
+      refresh_ms = interval;
+
+    /* Callback times have ms resolution: allow half an interval of slack */
+    if (refresh_ms > 0 && interval * 2 > refresh_ms * 3)
+      dropped += (interval + refresh_ms / 2) / refresh_ms - 1;
+  }
+  last_presented = time_ms;
+  have_presented = true;
+}
+
+void stats_reset_presentation(void) { have_presented = false; }
+
+double stats_last_frame_ms(void) {
+  if (sample_count == 0)
+    return 0;
+  return samples[(sample_next + MAX_SAMPLES - 1) % MAX_SAMPLES];
+}
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+QualityTier stats_last_tier(void) { return last_tier; }
+
+double stats_p99_frame_ms(void) {
+  if (sample_count == 0)
+    return 0;
+
+  double sorted[MAX_SAMPLES];
+  memcpy(sorted, samples, sample_count * sizeof(double));
+  qsort(sorted, sample_count, sizeof(double), compare_double);
+  return sorted[(sample_count * 99) / 100];
+}
+
+void stats_log(void) {
+  if (frames == 0)
+    return;
+  LOG("%lu frames, %lu over %.1f ms budget, %lu dropped, last %.2f ms, "
+      "p99 %.2f ms",
+      frames, over_budget, budget, dropped, stats_last_frame_ms(),
+      stats_p99_frame_ms());
+
+  if (tier_frames[QUALITY_BEST] == frames)
+    return;
+  char tiers[128] = "";
+  size_t len = 0;
+  for (int t = 0; t < QUALITY_COUNT && len < sizeof(tiers); t++) {
+    len += snprintf(tiers + len, sizeof(tiers) - len, "%s%s %lu",
+                    t ? ", " : "", governor_tier_name(t), tier_frames[t]);
+  }
+  LOG("Frames per quality tier: %s", tiers);
+}
@@ -0,0 +1,35 @@
+/* src/stats.h - Frame Timing Statistics */
+#ifndef STATS_H
+#define STATS_H
+
+#include "governor.h"
+#include <stdint.h>
+
+/* Per-frame render budget when the config sets none: a 144 Hz frame is
+ * 6.9 ms, and rendering must leave the compositor room to composite it */
+#define FRAME_BUDGET_MS 4.0
+
+/* Record the CPU time spent producing one frame, the budget it had
+ * (<= 0 for FRAME_BUDGET_MS) and the quality tier it was drawn at */
+void stats_record_frame(double render_ms, double budget_ms, QualityTier tier);
+
+/* Record a wl_surface.frame callback timestamp (ms) while animating.
+ * Gaps of more than one refresh interval count as dropped frames. */
+void stats_frame_presented(uint32_t time_ms);
+
+/* Forget the previous presentation time (an animation starts) */
+void stats_reset_presentation(void);
+
+/* Render time of the most recent frame and the 99th percentile of the
+ * recent ones, in ms */
+double stats_last_frame_ms(void);
+double stats_p99_frame_ms(void);
+
+/* Tier of the most recent frame */
+QualityTier stats_last_tier(void);
+
+/* Log frame counts, budget overruns, dropped frames, timings and the
+ * frames drawn below the best tier */
+void stats_log(void);
+
+#endif /* STATS_H */
@@ -0,0 +1,241 @@
+/* src/text.c - Font and Shaped Text Cache
+ *
+ * Pango shaping and ellipsizing is the most expensive part of a card, so
+ * shaped layouts are kept in an LRU cache keyed by (text, width, size,
+ * alignment).
+ * All layouts share one PangoContext and font descriptions are built once
+ * per config instead of once per string.
+ *
+ * Pango objects must not be shared between threads, so all of this state
+ * is per thread: the render thread and each tile worker shape with their
+ * own context and cache. text_invalidate() only reaches the caller's
+ * cache; other threads age stale layouts out through the LRU.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "text.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Text] " fmt "\n", ##__VA_ARGS__)
+#define MAX_LAYOUTS 256
+#define MAX_SIZES 8
+
+/* Width used for labels, which are never ellipsized */
+#define LABEL_WIDTH -1
+
+typedef struct {
+  char *text;
+  unsigned int hash;
+  int width;
+  int size;
+  PangoAlignment align;
+  PangoLayout *layout;
+  unsigned long access_time; /* LRU timestamp */
+} TextCacheEntry;
+
+typedef struct {
+  int size;
+  PangoFontDescription *desc;
+} SizedFont;
+
+static _Thread_local PangoContext *context = NULL;
+static _Thread_local char font_family[64] = "";
+static _Thread_local char font_weight[32] = "";
+static _Thread_local SizedFont fonts[MAX_SIZES];
+static _Thread_local int font_count = 0;
+
+/* Holds the last layout that could not be cached (out of memory) */
+static _Thread_local PangoLayout *scratch = NULL;
+
+static _Thread_local TextCacheEntry text_cache[MAX_LAYOUTS];
+static _Thread_local int cache_count = 0;
+static _Thread_local unsigned long lru_counter = 0;
+
+static unsigned int hash_text(const char *str) {
+  unsigned int hash = 5381;
+  int c;
+  while ((c = *str++))
+    hash = ((hash << 5) + hash) + c;
+  return hash;
+}
+
+static void clear_layouts(void) {
+  for (int i = 0; i < cache_count; i++) {
+    free(text_cache[i].text);
+    g_object_unref(text_cache[i].layout);
+  }
+  memset(text_cache, 0, sizeof(text_cache));
+  cache_count = 0;
+  lru_counter = 0;
+}
+
+static void clear_fonts(void) {
+  for (int i = 0; i < font_count; i++)
+    pango_font_description_free(fonts[i].desc);
+  font_count = 0;
+}
+
+bool text_update(const Config *cfg) {
+  const char *family = cfg ? cfg->font_family : "Sans";
+  const char *weight = cfg ? cfg->font_weight : "Bold";
+
+  if (context && strcmp(family, font_family) == 0 &&
+      strcmp(weight, font_weight) == 0)
+    return false;
+
+  if (!context)
+    context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+
+  strncpy(font_family, family, sizeof(font_family) - 1);
+  strncpy(font_weight, weight, sizeof(font_weight) - 1);
+  clear_layouts();
+  clear_fonts();
+  LOG("Font: %s %s", font_family, font_weight);
+  return true;
+}
+
+/* Font description for a size in Pango units, built once per config */
+static const PangoFontDescription *font_for_size(int size) {
+  for (int i = 0; i < font_count; i++) {
+    if (fonts[i].size == size)
+      return fonts[i].desc;
+  }
+
+  PangoWeight weight = PANGO_WEIGHT_BOLD;
+  if (strcasecmp(font_weight, "Normal") == 0)
+    weight = PANGO_WEIGHT_NORMAL;
+
+  PangoFontDescription *desc = pango_font_description_new();
+  pango_font_description_set_family(desc, font_family);
+  pango_font_description_set_weight(desc, weight);
+  pango_font_description_set_size(desc, size);
+
+  /* Only a handful of sizes are ever used; recycle the oldest if not */
+  if (font_count == MAX_SIZES) {
+    pango_font_description_free(fonts[0].desc);
+    memmove(&fonts[0], &fonts[1], (MAX_SIZES - 1) * sizeof(SizedFont));
+    font_count--;
+  }
+  fonts[font_count].size = size;
+  fonts[font_count].desc = desc;
+  font_count++;
+  return desc;
+}
+
+static void remove_entry(int i) {
+  free(text_cache[i].text);
+  g_object_unref(text_cache[i].layout);
+  if (i < cache_count - 1)
+    text_cache[i] = text_cache[cache_count - 1];
+  memset(&text_cache[cache_count - 1], 0, sizeof(TextCacheEntry));
+  cache_count--;
+}
+
+static void evict_lru_entry(void) {
+  int lru_index = 0;
+  for (int i = 1; i < cache_count; i++) {
+    if (text_cache[i].access_time < text_cache[lru_index].access_time)
+      lru_index = i;
+  }
+  remove_entry(lru_index);
+}
+
+static PangoLayout *get_layout(const char *text, int width, int size,
+                               PangoAlignment align) {
+  if (!context)
+    text_update(NULL);
+  if (!text)
+    text = "";
+
+  unsigned int hash = hash_text(text);
+  for (int i = 0; i < cache_count; i++) {
+    TextCacheEntry *e = &text_cache[i];
+    if (e->hash == hash && e->width == width && e->size == size &&
+        e->align == align && strcmp(e->text, text) == 0) {
+      e->access_time = ++lru_counter;
+      return e->layout;
+    }
+  }
+
+  PangoLayout *layout = pango_layout_new(context);
+  pango_layout_set_font_description(layout, font_for_size(size));
+  if (width != LABEL_WIDTH) {
+    pango_layout_set_width(layout, width * PANGO_SCALE);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+    pango_layout_set_alignment(layout, align);
+  }
+  pango_layout_set_text(layout, text, -1);
+
+  char *copy = strdup(text);
+  if (!copy) {
+    if (scratch)
+      g_object_unref(scratch);
+    scratch = layout;
+    return layout;
+  }
+
+  if (cache_count >= MAX_LAYOUTS)
+    evict_lru_entry();
+
+  TextCacheEntry *e = &text_cache[cache_count++];
+  e->text = copy;
+  e->hash = hash;
+  e->width = width;
+  e->size = size;
+  e->align = align;
+  e->layout = layout;
+  e->access_time = ++lru_counter;
+  return layout;
+}
+
+PangoLayout *text_title_layout(const char *title, int width, int size) {
+  return get_layout(title, width, size, PANGO_ALIGN_CENTER);
+}
+
+PangoLayout *text_row_layout(const char *text, int width, int size) {
+  return get_layout(text, width, size, PANGO_ALIGN_LEFT);
+}
+
+PangoLayout *text_label_layout(const char *text, int size) {
+  return get_layout(text, LABEL_WIDTH, size, PANGO_ALIGN_LEFT);
+}
+
+PangoContext *text_context(void) {
+  if (!context)
+    text_update(NULL);
+  return context;
+}
+
+const PangoFontDescription *text_font(int size) {
+  if (!context)
+    text_update(NULL);
+  return font_for_size(size);
+}
+
+void text_invalidate(const char *text) {
+  if (!text)
+    return;
+  unsigned int hash = hash_text(text);
+  for (int i = cache_count - 1; i >= 0; i--) {
+    if (text_cache[i].hash == hash && strcmp(text_cache[i].text, text) == 0)
+      remove_entry(i);
+  }
+}
+
+void text_cleanup(void) {
+  clear_layouts();
+  clear_fonts();
+  if (scratch) {
+    g_object_unref(scratch);
+    scratch = NULL;
+  }
+  if (context) {
+    g_object_unref(context);
+    context = NULL;
+  }
+  font_family[0] = '\0';
+  font_weight[0] = '\0';
+}
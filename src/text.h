@@ -0,0 +1,39 @@
+/* src/text.h - Font and Shaped Text Cache */
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "config.h"
+#include <pango/pangocairo.h>
+#include <stdbool.h>
+
+/* Everything below works on the calling thread's own context and cache */
+
+/* Rebuild the font description if family or weight changed.
+ * Returns true when cached layouts were dropped. */
+bool text_update(const Config *config);
+
+/* Sizes are in Pango units (points * PANGO_SCALE, times the output scale)
+ * so layouts shaped for different outputs are cached separately */
+
+/* Shaped title: ellipsized at width pixels and centered (borrowed) */
+PangoLayout *text_title_layout(const char *title, int width, int size);
+
+/* Shaped list row text: ellipsized at width pixels, left-aligned
+ * (borrowed) */
+PangoLayout *text_row_layout(const char *text, int width, int size);
+
+/* Shaped single-line label such as a letter or badge count (borrowed) */
+PangoLayout *text_label_layout(const char *text, int size);
+
+/* Shared context and font description for a size, for code that shapes
+ * outside the layout cache (borrowed) */
+PangoContext *text_context(void);
+const PangoFontDescription *text_font(int size);
+
+/* Drop every layout shaped for this text (window title changed) */
+void text_invalidate(const char *text);
+
+/* Free the calling thread's font descriptions, context and layouts */
+void text_cleanup(void);
+
+#endif /* TEXT_H */
@@ -0,0 +1,939 @@
+/* src/thumbnails.c - Live Window Thumbnails
+ *
+ * Windows are captured with ext-image-copy-capture-v1, using toplevel
+ * sources from ext-foreign-toplevel-list-v1, into wl_shm buffers. Every
+ * step is an event on the main loop, so showing the panel never waits
+ * for a capture: cards draw the icon until a thumbnail exists.
+ *
+ * Windows are captured when the panel is shown, and a single window again
+ * when its title or app_id changes, but never twice within refresh_ms.
+ * At most max_captures run at once, the rest wait in a queue. Finished
+ * captures are shrunk with the vectorized downscaler to fit the card and
+ * kept within a memory budget, the least recently drawn going first.
+ *
+ * The backend lists windows through wlr-foreign-toplevel, which has no
+ * capture source, so windows are matched to ext toplevels by app_id and
+ * title. A window whose app_id and title are shared with another one
+ * cannot be told apart and keeps its icon.
+ *
+ * Capturing runs on the main thread; the render thread only takes
+ * references to finished thumbnails under the lock.
+ *
+ * The capture protocols need wayland-protocols >= 1.37 at build time.
+ * Without them (no HAVE_CAPTURE) the API below is stubbed out and cards
+ * always show icons.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "thumbnails.h"
+#include "buffer_pool.h"
+#include "downscale.h"
+#ifdef HAVE_CAPTURE
+#include "ext-foreign-toplevel-list-v1-client-protocol.h"
+#include "ext-image-capture-source-v1-client-protocol.h"
+#include "ext-image-copy-capture-v1-client-protocol.h"
+#endif
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Thumbs] " fmt "\n", ##__VA_ARGS__)
+
+#define MAX_THUMBNAILS 256
+#define CAPTURE_ALL_TIMEOUT_MS 5000
+
+thumbnail_ready_callback_t on_thumbnail_ready = NULL;
+
+#ifdef HAVE_CAPTURE
+
+/* A window as ext-foreign-toplevel-list reports it */
+typedef struct Toplevel Toplevel;
+struct Toplevel {
+  struct ext_foreign_toplevel_handle_v1 *handle;
+  char *title;
+  char *app_id;
+  char *identifier;
+  char *key; /* Window it was last matched to on a show, or NULL */
+  Toplevel *next;
+};
+
+/* One capture, queued or running */
+typedef struct Capture Capture;
+struct Capture {
+  char *key;          /* Identifier of the window it is for */
+  Toplevel *toplevel; /* NULL once the window closed */
+  struct ext_image_capture_source_v1 *source;
+  struct ext_image_copy_capture_session_v1 *session;
+  struct ext_image_copy_capture_frame_v1 *frame;
+  uint32_t width;
+  uint32_t height;
+  int64_t format; /* -1 until the compositor offers one we can read */
+  int fd;
+  void *data;
+  size_t size;
+  struct wl_shm_pool *pool;
+  struct wl_buffer *buffer;
+  Capture *next;
+};
+
+/* A window's thumbnail, or only when it was last tried */
+typedef struct {
+  char *identifier;
+  cairo_surface_t *surface; /* NULL until a capture succeeded */
+  size_t bytes;
+  long captured_ms; /* Last attempt, for throttling (main thread) */
+  unsigned long access_time;
+} Thumbnail;
+
+/* Globals and limits (main thread) */
+static bool enabled = false;
+static int max_captures = 2;
+static size_t memory_budget = 32u << 20;
+static long refresh_ms = 2000;
+static int box_w = 140; /* Logical size thumbnails are fitted into */
+static int box_h = 90;
+static uint32_t scale120 = 120; /* Largest output scale seen */
+
+static struct wl_shm *shm = NULL;
+static struct ext_foreign_toplevel_list_v1 *toplevel_list = NULL;
+static struct ext_foreign_toplevel_image_capture_source_manager_v1
+    *source_manager = NULL;
+static struct ext_image_copy_capture_manager_v1 *capture_manager = NULL;
+static bool warned_unsupported = false;
+
+static Toplevel *toplevels = NULL;
+static Capture *queued = NULL; /* FIFO */
+static Capture *active = NULL;
+static int active_count = 0;
+
+/* Finished thumbnails, shared with the render thread */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static Thumbnail thumbnails[MAX_THUMBNAILS];
+static int thumbnail_count = 0;
+static size_t thumbnail_bytes = 0;
+static unsigned long lru_counter = 0;
+
+static long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* --- Thumbnail store (callers hold the lock) --- */
+
+static Thumbnail *find_thumbnail(const char *identifier) {
+  for (int i = 0; i < thumbnail_count; i++) {
+    if (strcmp(thumbnails[i].identifier, identifier) == 0)
+      return &thumbnails[i];
+  }
+  return NULL;
+}
+
+static void drop_surface(Thumbnail *t) {
+  if (t->surface) {
+    cairo_surface_destroy(t->surface);
+    thumbnail_bytes -= t->bytes;
+  }
+  t->surface = NULL;
+  t->bytes = 0;
+}
+
+static void remove_thumbnail(int i) {
+  drop_surface(&thumbnails[i]);
+  free(thumbnails[i].identifier);
+  thumbnails[i] = thumbnails[--thumbnail_count];
+  memset(&thumbnails[thumbnail_count], 0, sizeof(Thumbnail));
+}
+
+/* Least recently drawn entry other than keep, optionally only among the
+ * ones holding pixels */
+static int lru_thumbnail(const Thumbnail *keep, bool with_surface) {
+  int lru = -1;
+  for (int i = 0; i < thumbnail_count; i++) {
+    if (&thumbnails[i] == keep || (with_surface && !thumbnails[i].surface))
+      continue;
+    if (lru < 0 || thumbnails[i].access_time < thumbnails[lru].access_time)
+      lru = i;
+  }
+  return lru;
+}
+
+static Thumbnail *add_thumbnail(const char *identifier) {
+  Thumbnail *t = find_thumbnail(identifier);
+  if (t)
+    return t;
+
+  char *copy = strdup(identifier);
+  if (!copy)
+    return NULL;
+  if (thumbnail_count == MAX_THUMBNAILS)
+    remove_thumbnail(lru_thumbnail(NULL, false));
+
+  t = &thumbnails[thumbnail_count++];
+  memset(t, 0, sizeof(Thumbnail));
+  t->identifier = copy;
+  t->access_time = ++lru_counter;
+  return t;
+}
+
+/* --- ext-foreign-toplevel-list --- */
+
+static void pump_captures(void);
+
+static void replace_string(char **field, const char *value) {
+  free(*field);
+  *field = strdup(value ? value : "");
+}
+
+static void toplevel_closed(void *data,
+                            struct ext_foreign_toplevel_handle_v1 *handle) {
+  Toplevel *toplevel = data;
+
+  for (Toplevel **p = &toplevels; *p; p = &(*p)->next) {
+    if (*p == toplevel) {
+      *p = toplevel->next;
+      break;
+    }
+  }
+  /* Running sessions get stopped by the compositor; queued ones are
+   * skipped */
+  for (Capture *c = queued; c; c = c->next) {
+    if (c->toplevel == toplevel)
+      c->toplevel = NULL;
+  }
+  for (Capture *c = active; c; c = c->next) {
+    if (c->toplevel == toplevel)
+      c->toplevel = NULL;
+  }
+
+  ext_foreign_toplevel_handle_v1_destroy(handle);
+  free(toplevel->title);
+  free(toplevel->app_id);
+  free(toplevel->identifier);
+  free(toplevel->key);
+  free(toplevel);
+}
+
+static bool request_capture(const char *key, Toplevel *toplevel, long now);
+
+/* A window's title or app_id changed: capture that window again, if a
+ * show has tied it to one */
+static void toplevel_done(void *data,
+                          struct ext_foreign_toplevel_handle_v1 *handle) {
+  Toplevel *toplevel = data;
+  (void)handle;
+  if (toplevel->key && request_capture(toplevel->key, toplevel, now_ms()))
+    pump_captures();
+}
+
+static void toplevel_title(void *data,
+                           struct ext_foreign_toplevel_handle_v1 *handle,
+                           const char *title) {
+  (void)handle;
+  replace_string(&((Toplevel *)data)->title, title);
+}
+
+static void toplevel_app_id(void *data,
+                            struct ext_foreign_toplevel_handle_v1 *handle,
+                            const char *app_id) {
+  (void)handle;
+  replace_string(&((Toplevel *)data)->app_id, app_id);
+}
+
+static void toplevel_identifier(void *data,
+                                struct ext_foreign_toplevel_handle_v1 *handle,
+                                const char *identifier) {
+  (void)handle;
+  replace_string(&((Toplevel *)data)->identifier, identifier);
+}
+
+static const struct ext_foreign_toplevel_handle_v1_listener
+    toplevel_listener = {
+        .closed = toplevel_closed,
+        .done = toplevel_done,
+        .title = toplevel_title,
+        .app_id = toplevel_app_id,
+        .identifier = toplevel_identifier,
+};
+
+static void list_toplevel(void *data, struct ext_foreign_toplevel_list_v1 *list,
+                          struct ext_foreign_toplevel_handle_v1 *handle) {
+  (void)data;
+  (void)list;
+
+  Toplevel *toplevel = calloc(1, sizeof(Toplevel));
+  if (!toplevel) {
+    ext_foreign_toplevel_handle_v1_destroy(handle);
+    return;
+  }
+  toplevel->handle = handle;
+  toplevel->next = toplevels;
+  toplevels = toplevel;
+  ext_foreign_toplevel_handle_v1_add_listener(handle, &toplevel_listener,
+                                              toplevel);
+}
+
+static void list_finished(void *data,
+                          struct ext_foreign_toplevel_list_v1 *list) {
+  (void)data;
+  ext_foreign_toplevel_list_v1_destroy(list);
+  toplevel_list = NULL;
+}
+
+static const struct ext_foreign_toplevel_list_v1_listener list_listener = {
+    .toplevel = list_toplevel,
+    .finished = list_finished,
+};
+
+/* The only toplevel with this app_id and title, or NULL */
+static Toplevel *match_toplevel(const char *app_id, const char *title) {
+  Toplevel *match = NULL;
+  for (Toplevel *t = toplevels; t; t = t->next) {
+    if (!t->app_id || !t->title || strcmp(t->app_id, app_id) != 0 ||
+        strcmp(t->title, title) != 0)
+      continue;
+    if (match)
+      return NULL; /* Ambiguous */
+    match = t;
+  }
+  return match;
+}
+
+/* --- Captures --- */
+
+static void unlink_capture(Capture **list, Capture *c) {
+  for (Capture **p = list; *p; p = &(*p)->next) {
+    if (*p == c) {
+      *p = c->next;
+      return;
+    }
+  }
+}
+
+static void free_capture(Capture *c) {
+  if (c->frame)
+    ext_image_copy_capture_frame_v1_destroy(c->frame);
+  if (c->session)
+    ext_image_copy_capture_session_v1_destroy(c->session);
+  if (c->source)
+    ext_image_capture_source_v1_destroy(c->source);
+  if (c->buffer)
+    wl_buffer_destroy(c->buffer);
+  if (c->pool)
+    wl_shm_pool_destroy(c->pool);
+  if (c->data)
+    munmap(c->data, c->size);
+  if (c->fd >= 0)
+    close(c->fd);
+  free(c->key);
+  free(c);
+}
+
+/* End a running capture and start the next queued one */
+static void finish_capture(Capture *c, const char *error) {
+  if (error)
+    LOG("Capture of %s failed: %s", c->key, error);
+  unlink_capture(&active, c);
+  active_count--;
+  free_capture(c);
+  pump_captures();
+}
+
+/* Fit the captured pixels into the card and publish them */
+static void store_thumbnail(Capture *c) {
+  double scale = scale120 / 120.0;
+  double fit_w = box_w * scale / c->width;
+  double fit_h = box_h * scale / c->height;
+  double fit = fit_w < fit_h ? fit_w : fit_h;
+  if (fit > 1.0)
+    fit = 1.0;
+  int w = (int)lround(c->width * fit);
+  int h = (int)lround(c->height * fit);
+  if (w < 1)
+    w = 1;
+  if (h < 1)
+    h = 1;
+
+  cairo_surface_t *surface =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+  if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(surface);
+    return;
+  }
+  cairo_surface_flush(surface);
+  unsigned char *dst = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  if (downscale_argb32(downscale_best_kernel(), c->data, c->width,
+                       c->height, c->width * 4, dst, w, h, stride) < 0) {
+    cairo_surface_destroy(surface);
+    return;
+  }
+  if (c->format == WL_SHM_FORMAT_XRGB8888) {
+    for (int y = 0; y < h; y++) {
+      uint32_t *row = (uint32_t *)(dst + (size_t)y * stride);
+      for (int x = 0; x < w; x++)
+        row[x] |= 0xff000000u;
+    }
+  }
+  cairo_surface_mark_dirty(surface);
+
+  pthread_mutex_lock(&lock);
+  Thumbnail *t = add_thumbnail(c->key);
+  if (t) {
+    drop_surface(t);
+    t->surface = surface;
+    t->bytes = (size_t)stride * h;
+    thumbnail_bytes += t->bytes;
+    while (thumbnail_bytes > memory_budget) {
+      int lru = lru_thumbnail(t, true);
+      if (lru < 0)
+        break;
+      drop_surface(&thumbnails[lru]);
+    }
+  } else {
+    cairo_surface_destroy(surface);
+  }
+  pthread_mutex_unlock(&lock);
+
+  if (t && on_thumbnail_ready)
+    on_thumbnail_ready(c->key);
+}
+
+static void frame_transform(void *data,
+                            struct ext_image_copy_capture_frame_v1 *frame,
+                            uint32_t transform) {
+  (void)data;
+  (void)frame;
+  (void)transform;
+}
+
+static void frame_damage(void *data,
+                         struct ext_image_copy_capture_frame_v1 *frame,
+                         int32_t x, int32_t y, int32_t w, int32_t h) {
+  (void)data;
+  (void)frame;
+  (void)x;
+  (void)y;
+  (void)w;
+  (void)h;
+}
+
+static void frame_presentation_time(
+    void *data, struct ext_image_copy_capture_frame_v1 *frame,
+    uint32_t sec_hi, uint32_t sec_lo, uint32_t nsec) {
+  (void)data;
+  (void)frame;
+  (void)sec_hi;
+  (void)sec_lo;
+  (void)nsec;
+}
+
+static void frame_ready(void *data,
+                        struct ext_image_copy_capture_frame_v1 *frame) {
+  (void)frame;
+  Capture *c = data;
+  store_thumbnail(c);
+  finish_capture(c, NULL);
+}
+
+static void frame_failed(void *data,
+                         struct ext_image_copy_capture_frame_v1 *frame,
+                         uint32_t reason) {
+  (void)frame;
+  (void)reason;
+  finish_capture(data, "frame failed");
+}
+
+static const struct ext_image_copy_capture_frame_v1_listener
+    frame_listener = {
+        .transform = frame_transform,
+        .damage = frame_damage,
+        .presentation_time = frame_presentation_time,
+        .ready = frame_ready,
+        .failed = frame_failed,
+};
+
+static void session_buffer_size(
+    void *data, struct ext_image_copy_capture_session_v1 *session,
+    uint32_t width, uint32_t height) {
+  (void)session;
+  Capture *c = data;
+  c->width = width;
+  c->height = height;
+}
+
+static void session_shm_format(void *data,
+                               struct ext_image_copy_capture_session_v1 *session,
+                               uint32_t format) {
+  (void)session;
+  Capture *c = data;
+  /* Both are what Cairo calls ARGB32 and RGB24; prefer alpha */
+  if (format == WL_SHM_FORMAT_ARGB8888 ||
+      (format == WL_SHM_FORMAT_XRGB8888 && c->format < 0))
+    c->format = format;
+}
+
+static void session_dmabuf_device(
+    void *data, struct ext_image_copy_capture_session_v1 *session,
+    struct wl_array *device) {
+  (void)data;
+  (void)session;
+  (void)device;
+}
+
+static void session_dmabuf_format(
+    void *data, struct ext_image_copy_capture_session_v1 *session,
+    uint32_t format, struct wl_array *modifiers) {
+  (void)data;
+  (void)session;
+  (void)format;
+  (void)modifiers;
+}
+
+static bool alloc_buffer(Capture *c) {
+  int stride = (int)c->width * 4;
+  c->size = (size_t)stride * c->height;
+  c->fd = create_shm_file(c->size);
+  if (c->fd < 0)
+    return false;
+  void *data =
+      mmap(NULL, c->size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+  if (data == MAP_FAILED)
+    return false;
+  c->data = data;
+  c->pool = wl_shm_create_pool(shm, c->fd, c->size);
+  c->buffer = wl_shm_pool_create_buffer(c->pool, 0, c->width, c->height,
+                                        stride, (uint32_t)c->format);
+  return true;
+}
+
+/* Buffer constraints are known: capture one frame */
+static void session_done(void *data,
+                         struct ext_image_copy_capture_session_v1 *session) {
+  Capture *c = data;
+  if (c->frame)
+    return; /* Constraints changed mid-capture; the frame will fail */
+
+  if (c->format < 0 || c->width == 0 || c->height == 0) {
+    finish_capture(c, "no shm format");
+    return;
+  }
+  if (!alloc_buffer(c)) {
+    finish_capture(c, strerror(errno));
+    return;
+  }
+
+  c->frame = ext_image_copy_capture_session_v1_create_frame(session);
+  ext_image_copy_capture_frame_v1_add_listener(c->frame, &frame_listener, c);
+  ext_image_copy_capture_frame_v1_attach_buffer(c->frame, c->buffer);
+  ext_image_copy_capture_frame_v1_damage_buffer(c->frame, 0, 0, c->width,
+                                                c->height);
+  ext_image_copy_capture_frame_v1_capture(c->frame);
+}
+
+static void session_stopped(void *data,
+                            struct ext_image_copy_capture_session_v1 *session) {
+  (void)session;
+  finish_capture(data, "session stopped");
+}
+
+static const struct ext_image_copy_capture_session_v1_listener
+    session_listener = {
+        .buffer_size = session_buffer_size,
+        .shm_format = session_shm_format,
+        .dmabuf_device = session_dmabuf_device,
+        .dmabuf_format = session_dmabuf_format,
+        .done = session_done,
+        .stopped = session_stopped,
+};
+
+/* Start queued captures up to the concurrency limit */
+static void pump_captures(void) {
+  while (queued && active_count < max_captures) {
+    Capture *c = queued;
+    queued = c->next;
+    if (!c->toplevel) {
+      free_capture(c); /* Closed while waiting */
+      continue;
+    }
+
+    c->source =
+        ext_foreign_toplevel_image_capture_source_manager_v1_create_source(
+            source_manager, c->toplevel->handle);
+    c->session = ext_image_copy_capture_manager_v1_create_session(
+        capture_manager, c->source, 0);
+    ext_image_copy_capture_session_v1_add_listener(c->session,
+                                                   &session_listener, c);
+    c->next = active;
+    active = c;
+    active_count++;
+  }
+}
+
+static bool capture_pending(const char *key) {
+  for (Capture *c = active; c; c = c->next) {
+    if (strcmp(c->key, key) == 0)
+      return true;
+  }
+  for (Capture *c = queued; c; c = c->next) {
+    if (strcmp(c->key, key) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void queue_capture(const char *key, Toplevel *toplevel) {
+  Capture *c = calloc(1, sizeof(Capture));
+  if (!c)
+    return;
+  c->key = strdup(key);
+  if (!c->key) {
+    free(c);
+    return;
+  }
+  c->toplevel = toplevel;
+  c->format = -1;
+  c->fd = -1;
+
+  Capture **tail = &queued;
+  while (*tail)
+    tail = &(*tail)->next;
+  *tail = c;
+}
+
+/* Queue a capture of a window unless one is pending or its last attempt
+ * was less than refresh_ms ago. Returns whether one was queued. */
+static bool request_capture(const char *key, Toplevel *toplevel, long now) {
+  if (capture_pending(key))
+    return false;
+
+  pthread_mutex_lock(&lock);
+  Thumbnail *t = find_thumbnail(key);
+  bool fresh = t && t->captured_ms && now - t->captured_ms < refresh_ms;
+  if (!fresh) {
+    /* Failed attempts are throttled too */
+    t = add_thumbnail(key);
+    if (t)
+      t->captured_ms = now;
+  }
+  pthread_mutex_unlock(&lock);
+  if (fresh)
+    return false;
+
+  queue_capture(key, toplevel);
+  return true;
+}
+
+static bool can_capture(void) {
+  return enabled && shm && toplevel_list && source_manager &&
+         capture_manager;
+}
+
+/* --- Public API --- */
+
+bool thumbnails_init(const Config *config) {
+  enabled = config && config->thumbnails;
+  if (!enabled)
+    return false;
+
+  max_captures =
+      config->thumbnail_captures > 0 ? config->thumbnail_captures : 1;
+  memory_budget = (size_t)(config->thumbnail_memory_mb > 0
+                               ? config->thumbnail_memory_mb
+                               : 1)
+                  << 20;
+  refresh_ms = config->thumbnail_refresh_ms;
+
+  /* The part of the card below the title that the icon sits in */
+  box_w = config->card_width - 20;
+  box_h = config->card_height - 50;
+  if (box_w < 1)
+    box_w = 1;
+  if (box_h < 1)
+    box_h = 1;
+  return true;
+}
+
+void thumbnails_bind(struct wl_registry *registry, uint32_t name,
+                     const char *interface, uint32_t version) {
+  (void)version;
+  if (!enabled)
+    return;
+
+  if (strcmp(interface, wl_shm_interface.name) == 0) {
+    shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+  } else if (strcmp(interface, ext_foreign_toplevel_list_v1_interface.name) ==
+             0) {
+    toplevel_list = wl_registry_bind(
+        registry, name, &ext_foreign_toplevel_list_v1_interface, 1);
+    ext_foreign_toplevel_list_v1_add_listener(toplevel_list, &list_listener,
+                                              NULL);
+  } else if (strcmp(interface,
+                    ext_foreign_toplevel_image_capture_source_manager_v1_interface
+                        .name) == 0) {
+    source_manager = wl_registry_bind(
+        registry, name,
+        &ext_foreign_toplevel_image_capture_source_manager_v1_interface, 1);
+  } else if (strcmp(interface,
+                    ext_image_copy_capture_manager_v1_interface.name) == 0) {
+    capture_manager = wl_registry_bind(
+        registry, name, &ext_image_copy_capture_manager_v1_interface, 1);
+    LOG("Bound image copy capture manager");
+  }
+}
+
+void thumbnails_set_scale(uint32_t scale) {
+  if (scale == 0)
+    scale = 120;
+  /* Previews are shrunk when cards are drawn, so one taken for a denser
+   * output serves every other: moving between monitors recaptures
+   * nothing */
+  if (scale <= scale120)
+    return;
+  scale120 = scale;
+
+  /* Too small now: keep showing them, but capture again on the next
+   * request */
+  pthread_mutex_lock(&lock);
+  for (int i = 0; i < thumbnail_count; i++)
+    thumbnails[i].captured_ms = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+void thumbnails_request(const AppState *state) {
+  if (!enabled || !state)
+    return;
+  if (!can_capture()) {
+    if (!warned_unsupported)
+      LOG("Compositor cannot capture windows, cards keep their icons");
+    warned_unsupported = true;
+    return;
+  }
+
+  long now = now_ms();
+  for (int i = 0; i < state->count; i++) {
+    const WindowInfo *win = &state->windows[i];
+    if (!win->address)
+      continue;
+
+    Toplevel *toplevel = match_toplevel(win->class_name ? win->class_name : "",
+                                        win->title ? win->title : "");
+    if (!toplevel)
+      continue;
+
+    /* Later changes to this toplevel recapture only this window */
+    if (!toplevel->key || strcmp(toplevel->key, win->address) != 0)
+      replace_string(&toplevel->key, win->address);
+    request_capture(win->address, toplevel, now);
+  }
+  pump_captures();
+}
+
+cairo_surface_t *thumbnails_get(const char *identifier) {
+  if (!enabled || !identifier)
+    return NULL;
+
+  cairo_surface_t *surface = NULL;
+  pthread_mutex_lock(&lock);
+  Thumbnail *t = find_thumbnail(identifier);
+  if (t && t->surface) {
+    surface = cairo_surface_reference(t->surface);
+    t->access_time = ++lru_counter;
+  }
+  pthread_mutex_unlock(&lock);
+  return surface;
+}
+
+void thumbnails_cleanup(void) {
+  while (queued) {
+    Capture *c = queued;
+    queued = c->next;
+    free_capture(c);
+  }
+  while (active) {
+    Capture *c = active;
+    active = c->next;
+    free_capture(c);
+  }
+  active_count = 0;
+
+  while (toplevels) {
+    Toplevel *t = toplevels;
+    toplevels = t->next;
+    ext_foreign_toplevel_handle_v1_destroy(t->handle);
+    free(t->title);
+    free(t->app_id);
+    free(t->identifier);
+    free(t->key);
+    free(t);
+  }
+  if (toplevel_list) {
+    ext_foreign_toplevel_list_v1_destroy(toplevel_list);
+    toplevel_list = NULL;
+  }
+  if (source_manager) {
+    ext_foreign_toplevel_image_capture_source_manager_v1_destroy(
+        source_manager);
+    source_manager = NULL;
+  }
+  if (capture_manager) {
+    ext_image_copy_capture_manager_v1_destroy(capture_manager);
+    capture_manager = NULL;
+  }
+  if (shm) {
+    wl_shm_destroy(shm);
+    shm = NULL;
+  }
+
+  pthread_mutex_lock(&lock);
+  while (thumbnail_count > 0)
+    remove_thumbnail(thumbnail_count - 1);
+  pthread_mutex_unlock(&lock);
+}
+
+/* --- Standalone capture test --- */
+
+static void test_registry_global(void *data, struct wl_registry *registry,
+                                 uint32_t name, const char *interface,
+                                 uint32_t version) {
+  (void)data;
+  thumbnails_bind(registry, name, interface, version);
+}
+
+static void test_registry_global_remove(void *data,
+                                        struct wl_registry *registry,
+                                        uint32_t name) {
+  (void)data;
+  (void)registry;
+  (void)name;
+}
+
+static const struct wl_registry_listener test_registry_listener = {
+    .global = test_registry_global,
+    .global_remove = test_registry_global_remove,
+};
+
+/* Dispatch until every capture finished or the timeout passed */
+static void wait_for_captures(struct wl_display *display) {
+  long deadline = now_ms() + CAPTURE_ALL_TIMEOUT_MS;
+  while (queued || active) {
+    long left = deadline - now_ms();
+    if (left <= 0) {
+      LOG("Timed out with captures still running");
+      return;
+    }
+    while (wl_display_prepare_read(display) != 0)
+      wl_display_dispatch_pending(display);
+    wl_display_flush(display);
+
+    struct pollfd pfd = {.fd = wl_display_get_fd(display), .events = POLLIN};
+    if (poll(&pfd, 1, (int)left) > 0) {
+      if (wl_display_read_events(display) < 0)
+        return;
+    } else {
+      wl_display_cancel_read(display);
+    }
+    if (wl_display_dispatch_pending(display) < 0)
+      return;
+  }
+}
+
+int thumbnails_capture_all(const char *dir) {
+  Config *config = get_default_config();
+  if (!config)
+    return 1;
+  config->thumbnails = true;
+  thumbnails_init(config);
+  free_config(config);
+
+  struct wl_display *display = wl_display_connect(NULL);
+  if (!display) {
+    fprintf(stderr, "Cannot connect to a Wayland compositor\n");
+    return 1;
+  }
+  struct wl_registry *registry = wl_display_get_registry(display);
+  wl_registry_add_listener(registry, &test_registry_listener, NULL);
+  wl_display_roundtrip(display); /* Globals */
+  wl_display_roundtrip(display); /* Toplevels and their properties */
+
+  int written = 0;
+  if (!can_capture()) {
+    fprintf(stderr, "Compositor cannot capture windows (needs "
+                    "ext-image-copy-capture-v1)\n");
+  } else {
+    int count = 0;
+    for (Toplevel *t = toplevels; t; t = t->next) {
+      char key[32];
+      snprintf(key, sizeof(key), "window-%d", count++);
+      queue_capture(key, t);
+    }
+    pump_captures();
+    wait_for_captures(display);
+
+    for (int i = 0; i < count; i++) {
+      char key[32];
+      char path[1024];
+      snprintf(key, sizeof(key), "window-%d", i);
+      snprintf(path, sizeof(path), "%s/%s.png", dir, key);
+      cairo_surface_t *surface = thumbnails_get(key);
+      if (!surface) {
+        printf("%s: no capture\n", key);
+        continue;
+      }
+      if (cairo_surface_write_to_png(surface, path) == CAIRO_STATUS_SUCCESS) {
+        printf("%s: %dx%d\n", path, cairo_image_surface_get_width(surface),
+               cairo_image_surface_get_height(surface));
+        written++;
+      }
+      cairo_surface_destroy(surface);
+    }
+  }
+
+  thumbnails_cleanup();
+  wl_registry_destroy(registry);
+  wl_display_disconnect(display);
+  return written > 0 ? 0 : 1;
+}
+
+#else /* !HAVE_CAPTURE */
+
+bool thumbnails_init(const Config *config) {
+  if (config && config->thumbnails)
+    LOG("Thumbnails unavailable: built without wayland-protocols >= 1.37");
+  return false;
+}
+
+void thumbnails_bind(struct wl_registry *registry, uint32_t name,
+                     const char *interface, uint32_t version) {
+  (void)registry;
+  (void)name;
+  (void)interface;
+  (void)version;
+}
+
+void thumbnails_set_scale(uint32_t scale120) { (void)scale120; }
+
+void thumbnails_request(const AppState *state) { (void)state; }
+
+cairo_surface_t *thumbnails_get(const char *identifier) {
+  (void)identifier;
+  return NULL;
+}
+
+void thumbnails_cleanup(void) {}
+
+int thumbnails_capture_all(const char *dir) {
+  (void)dir;
+  fprintf(stderr, "Built without window capture (needs wayland-protocols "
+                  ">= 1.37)\n");
+  return 1;
+}
+
+#endif /* HAVE_CAPTURE */
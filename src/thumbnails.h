@@ -0,0 +1,46 @@
+/* src/thumbnails.h - Live Window Thumbnails */
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include "config.h"
+#include "data.h"
+#include <cairo/cairo.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-client.h>
+
+/* Callback when a window's thumbnail changed (set by main.c). Called from
+ * event dispatch. */
+typedef void (*thumbnail_ready_callback_t)(const char *identifier);
+extern thumbnail_ready_callback_t on_thumbnail_ready;
+
+/* Take limits from config, before the registry is read. Returns false
+ * if thumbnails are disabled (cards keep their icons). */
+bool thumbnails_init(const Config *config);
+
+/* Bind a global thumbnails need, if enabled; ignores the rest */
+void thumbnails_bind(struct wl_registry *registry, uint32_t name,
+                     const char *interface, uint32_t version);
+
+/* Sizes thumbnails for the largest output scale seen, in 1/120 units; a
+ * larger one has the next request capture every window again */
+void thumbnails_set_scale(uint32_t scale120);
+
+/* Queue captures for the windows of a panel being shown, skipping those
+ * captured within refresh_ms. Never waits: results arrive later through
+ * Wayland events. */
+void thumbnails_request(const AppState *state);
+
+/* Latest thumbnail of a window (new reference), or NULL if there is none
+ * yet. Safe from any thread. */
+cairo_surface_t *thumbnails_get(const char *identifier);
+
+/* Stop captures and free every thumbnail */
+void thumbnails_cleanup(void);
+
+/* Connect to the compositor, capture every window once and write them to
+ * dir as PNGs. For testing against a (headless) compositor. Returns 0 if
+ * at least one was written. */
+int thumbnails_capture_all(const char *dir);
+
+#endif /* THUMBNAILS_H */
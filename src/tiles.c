@@ -0,0 +1,141 @@
+/* src/tiles.c - Parallel Tile Workers
+ *
+ * A fixed set of threads that split a batch of tiles between them. Tiles
+ * are claimed from an atomic counter, so uneven tiles balance themselves.
+ * tiles_run() returns only when every tile is done, which makes each call
+ * a barrier between the phases of a frame.
+ */
+#define _GNU_SOURCE
+
+#include "tiles.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG(fmt, ...) fprintf(stderr, "[Tiles] " fmt "\n", ##__VA_ARGS__)
+
+static pthread_t workers[TILES_MAX_THREADS - 1];
+static int worker_count = 0; /* Threads besides the caller */
+static void (*exit_hook)(void) = NULL;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/* Current batch, published under lock */
+static tile_fn batch_fn = NULL;
+static void *batch_ctx = NULL;
+static int batch_count = 0;
+static unsigned long batch_serial = 0;
+static int batch_busy = 0; /* Workers not yet done with the batch */
+static bool quit = false;
+
+static atomic_int next_tile;
+
+static void run_tiles(void) {
+  int tile;
+  while ((tile = atomic_fetch_add(&next_tile, 1)) < batch_count)
+    batch_fn(batch_ctx, tile);
+}
+
+static void *worker_main(void *arg) {
+  (void)arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&lock);
+  for (;;) {
+    while (!quit && batch_serial == seen)
+      pthread_cond_wait(&work_cond, &lock);
+    if (quit)
+      break;
+    seen = batch_serial;
+    pthread_mutex_unlock(&lock);
+
+    run_tiles();
+
+    pthread_mutex_lock(&lock);
+    if (--batch_busy == 0)
+      pthread_cond_signal(&done_cond);
+  }
+  pthread_mutex_unlock(&lock);
+
+  if (exit_hook)
+    exit_hook();
+  return NULL;
+}
+
+static int online_cores(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+
+bool tiles_start(int threads, void (*thread_exit)(void)) {
+  tiles_stop();
+
+  if (threads <= 0)
+    threads = online_cores();
+  if (threads > TILES_MAX_THREADS)
+    threads = TILES_MAX_THREADS;
+
+  exit_hook = thread_exit;
+  quit = false;
+  for (int i = 0; i < threads - 1; i++) {
+    int err = pthread_create(&workers[i], NULL, worker_main, NULL);
+    if (err != 0) {
+      LOG("pthread_create failed: %s", strerror(err));
+      break;
+    }
+    worker_count++;
+  }
+
+  if (worker_count > 0)
+    LOG("%d threads per frame", worker_count + 1);
+  return worker_count > 0;
+}
+
+int tiles_threads(void) { return worker_count + 1; }
+
+void tiles_run(int count, tile_fn fn, void *ctx) {
+  if (count <= 0)
+    return;
+
+  if (worker_count == 0 || count == 1) {
+    for (int i = 0; i < count; i++)
+      fn(ctx, i);
+    return;
+  }
+
+  pthread_mutex_lock(&lock);
+  batch_fn = fn;
+  batch_ctx = ctx;
+  batch_count = count;
+  atomic_store(&next_tile, 0);
+  batch_busy = worker_count;
+  batch_serial++;
+  pthread_cond_broadcast(&work_cond);
+  pthread_mutex_unlock(&lock);
+
+  run_tiles();
+
+  pthread_mutex_lock(&lock);
+  while (batch_busy > 0)
+    pthread_cond_wait(&done_cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+void tiles_stop(void) {
+  if (worker_count == 0)
+    return;
+
+  pthread_mutex_lock(&lock);
+  quit = true;
+  pthread_cond_broadcast(&work_cond);
+  pthread_mutex_unlock(&lock);
+
+  for (int i = 0; i < worker_count; i++)
+    pthread_join(workers[i], NULL);
+  worker_count = 0;
+  quit = false;
+}
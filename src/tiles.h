@@ -0,0 +1,30 @@
+/* src/tiles.h - Parallel Tile Workers */
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdbool.h>
+
+/* Upper bound on threads working on one frame, including the caller */
+#define TILES_MAX_THREADS 16
+
+/* Draws one tile; called concurrently for different tiles */
+typedef void (*tile_fn)(void *ctx, int tile);
+
+/* Start workers so that threads (0 = one per online core) share each
+ * batch, counting the calling thread. thread_exit, if set, runs on every
+ * worker before it exits. Returns false if no worker could be started,
+ * in which case tiles_run() works serially. */
+bool tiles_start(int threads, void (*thread_exit)(void));
+
+/* Threads sharing a batch (1 when serial) */
+int tiles_threads(void);
+
+/* Run fn for every tile in [0, count) and return once all are done. The
+ * caller works on tiles too. Must not be called from two threads at
+ * once. */
+void tiles_run(int count, tile_fn fn, void *ctx);
+
+/* Stop and join the workers */
+void tiles_stop(void);
+
+#endif /* TILES_H */
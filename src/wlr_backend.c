@@ -25,6 +25,7 @@ struct WindowNode {
   int state;
   int is_active;
   int is_minimized;
+  struct wl_output *output; /* Last output entered (identity only) */
   WindowNode *next;
 };
 
@@ -102,9 +103,16 @@ toplevel_handle_title(void *data,
   WindowNode *window = (WindowNode *)data;
   (void)toplevel;
 
-  if (window->title)
-    free(window->title);
-  window->title = strdup(title ? title : "");
+  if (!title)
+    title = "";
+  if (window->title && strcmp(window->title, title) == 0)
+    return;
+
+  if (on_window_changed && window->identifier)
+    on_window_changed(window->identifier, window->title);
+
+  free(window->title);
+  window->title = strdup(title);
 }
 
 static void
@@ -114,27 +122,38 @@ toplevel_handle_app_id(void *data,
   WindowNode *window = (WindowNode *)data;
   (void)toplevel;
 
-  if (window->app_id)
-    free(window->app_id);
-  window->app_id = strdup(app_id ? app_id : "");
+  if (!app_id)
+    app_id = "";
+  if (window->app_id && strcmp(window->app_id, app_id) == 0)
+    return;
+
+  free(window->app_id);
+  window->app_id = strdup(app_id);
+
+  if (on_window_changed && window->identifier)
+    on_window_changed(window->identifier, NULL);
 }
 
 static void
 toplevel_handle_output_enter(void *data,
                              struct zwlr_foreign_toplevel_handle_v1 *toplevel,
                              struct wl_output *output) {
-  (void)data;
+  WindowNode *window = (WindowNode *)data;
   (void)toplevel;
-  (void)output;
+
+  /* A window spanning outputs belongs to the one it entered last */
+  window->output = output;
 }
 
 static void
 toplevel_handle_output_leave(void *data,
                              struct zwlr_foreign_toplevel_handle_v1 *toplevel,
                              struct wl_output *output) {
-  (void)data;
+  WindowNode *window = (WindowNode *)data;
   (void)toplevel;
-  (void)output;
+
+  if (window->output == output)
+    window->output = NULL;
 }
 
 static void
@@ -171,6 +190,8 @@ toplevel_handle_done(void *data,
   (void)toplevel;
 
   backend_state.needs_refresh = 1;
+  if (on_list_changed)
+    on_list_changed();
 }
 
 static void
@@ -192,6 +213,9 @@ toplevel_handle_closed(void *data,
     curr = curr->next;
   }
 
+  if (on_window_changed && window->identifier)
+    on_window_changed(window->identifier, window->title);
+
   if (window->handle) {
     zwlr_foreign_toplevel_handle_v1_destroy(window->handle);
   }
@@ -201,6 +225,8 @@ toplevel_handle_closed(void *data,
   free(window);
 
   backend_state.needs_refresh = 1;
+  if (on_list_changed)
+    on_list_changed();
 }
 
 static void
@@ -437,4 +463,12 @@ void wlr_activate_window(const char *identifier) {
   LOG("Window not found: %s", identifier);
 }
 
-const char *wlr_get_name(void) { return "wlr"; }
\ No newline at end of file
+const char *wlr_get_name(void) { return "wlr"; }
+
+struct wl_output *wlr_get_active_output(void) {
+  for (WindowNode *w = backend_state.windows; w; w = w->next) {
+    if (w->is_active)
+      return w->output;
+  }
+  return NULL;
+}
@@ -21,4 +21,7 @@ void wlr_activate_window(const char *identifier);
 /* Get backend name */
 const char *wlr_get_name(void);
 
+/* Output the active window was last seen entering, or NULL */
+struct wl_output *wlr_get_active_output(void);
+
 #endif /* WLR_BACKEND_H */
\ No newline at end of file